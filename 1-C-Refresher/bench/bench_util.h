@@ -0,0 +1,58 @@
+#ifndef __BENCH_UTIL_H__
+#define __BENCH_UTIL_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+// Helpers shared by the microbenchmarks: a seeded xorshift generator, so
+// every run builds the same bytes, a random text filler and a monotonic
+// clock.
+#define BENCH_SEED  0x9e3779b97f4a7c15ULL
+
+static uint64_t rng_state = BENCH_SEED;
+
+static inline void rng_seed(uint64_t seed) {
+    rng_state = seed;
+}
+
+static inline uint64_t rng_next(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+static inline size_t rng_range(size_t lo, size_t hi) {
+    return lo + rng_next() % (hi - lo + 1);
+}
+
+// Words of 1 to 12 letters, each followed by a separator picked from seps.
+// With runs, one word in eight is followed by a run of 1 to 4 of them.
+static inline void fill_text(char *buf, size_t len, const char *seps, bool runs) {
+    size_t nseps = 0;
+    size_t i = 0;
+
+    while (seps[nseps] != '\0') {
+        nseps++;
+    }
+    while (i < len) {
+        size_t wlen = rng_range(1, 12);
+        for (size_t j = 0; j < wlen && i < len; j++) {
+            buf[i++] = 'a' + rng_next() % 26;
+        }
+        size_t slen = (runs && rng_next() % 8 == 0) ? rng_range(1, 4) : 1;
+        for (size_t j = 0; j < slen && i < len; j++) {
+            buf[i++] = seps[rng_next() % nseps];
+        }
+    }
+}
+
+static inline double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+#endif
@@ -0,0 +1,102 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "bench_util.h"
+#include "sflib.h"
+#include "sfout.h"
+
+// Output microbenchmark.  Runs the -w word listing over a large random text
+// twice with standard output sent to /dev/null: once with the old
+// printf-per-character code and once through the buffered writer in
+// sfout.c.  Reports input MB/s and the speedup.
+//
+//   usage: out_bench [size_mb]
+
+#define DEF_SIZE_MB     32
+#define TEXT_SEPS       "\n         "  // one word in ten ends a line
+
+// The word listing as it was before sfout.c, one stdio call per character
+static void words_stdio(const char *data, size_t len) {
+    long word_count = 0;
+    size_t char_count = 0;
+
+    printf("Word Print\n----------\n");
+    for (size_t i = 0; i < len; i++) {
+        char c = data[i];
+        if (IS_WORD_SEP(c)) {
+            if (char_count > 0) {
+                printf(" (%zu)\n", char_count);
+                char_count = 0;
+                word_count++;
+            }
+        } else if (char_count == 0) {
+            printf("%ld. %c", word_count + 1, c);
+            char_count++;
+        } else {
+            printf("%c", c);
+            char_count++;
+        }
+    }
+    if (char_count > 0) {
+        printf(" (%zu)\n", char_count);
+    }
+    fflush(stdout);
+}
+
+static void words_buffered(const char *data, size_t len) {
+    words_state_t ws;
+
+    words_begin(&ws, false);
+    words_feed(&ws, data, len);
+    words_end(&ws);
+    out_flush();
+}
+
+int main(int argc, char *argv[]) {
+    size_t size_mb = argc > 1 ? strtoul(argv[1], NULL, 10) : DEF_SIZE_MB;
+    size_t len = size_mb * 1024 * 1024;
+
+    if (len == 0) {
+        fprintf(stderr, "usage: %s [size_mb]\n", argv[0]);
+        return 1;
+    }
+    char *buf = malloc(len);
+    if (buf == NULL) {
+        fprintf(stderr, "Error: Failed to allocate %zu MB\n", size_mb);
+        return 99;
+    }
+    fill_text(buf, len, TEXT_SEPS, false);
+
+    // Send standard output to /dev/null while timing
+    fflush(stdout);
+    int saved = dup(STDOUT_FILENO);
+    int null_fd = open("/dev/null", O_WRONLY);
+    if (saved < 0 || null_fd < 0 || dup2(null_fd, STDOUT_FILENO) < 0) {
+        perror("out_bench");
+        return 1;
+    }
+
+    double t0 = now_sec();
+    words_stdio(buf, len);
+    double t_stdio = now_sec() - t0;
+
+    t0 = now_sec();
+    words_buffered(buf, len);
+    double t_buf = now_sec() - t0;
+
+    dup2(saved, STDOUT_FILENO);
+    close(saved);
+    close(null_fd);
+
+    printf("%-8s %10s\n", "writer", "MB/s");
+    printf("%-8s %10.1f\n", "stdio", len / t_stdio / 1e6);
+    printf("%-8s %10.1f\n", "sfout", len / t_buf / 1e6);
+    printf("speedup  %9.1fx\n", t_stdio / t_buf);
+
+    free(buf);
+    return 0;
+}
@@ -0,0 +1,241 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "bench_util.h"
+#include "sflib.h"
+#include "sfout.h"
+
+// Buffer operation microbenchmark.  Builds each corpus below from a fixed
+// seed, so every run and every commit sees the same bytes, then times the
+// operations stringfun runs on its buffer.  Each one gets warmup runs
+// first and the median of the timed runs is reported as CSV, one line per
+// corpus and operation, to compare between commits.  bytes is what the
+// operation reads: the corpus for setup_buff, the squeezed string after it
+// for the others.
+//
+//   usage: sf_bench [size_mb] [reps]
+//          sf_bench -g corpus [size_mb]     write a corpus to stdout
+
+#define DEF_SIZE_MB     8
+#define DEF_REPS        10
+#define WARMUP_REPS     2
+#define NEEDLE          "#needle#"  // planted once, 9/10 of the way in
+
+typedef struct corpus {
+    const char *name;
+    int         min_word;   // letters per word
+    int         max_word;
+    int         max_spaces; // separator run length, 1 to max_spaces
+    int         utf8_pct;   // percent of letters that are multibyte
+} corpus_t;
+
+static const corpus_t CORPORA[] = {
+    { "short_words", 1,  4, 1,  0 },
+    { "long_words",  8, 24, 1,  0 },
+    { "sparse_ws",   4, 12, 1,  0 },
+    { "dense_ws",    1,  8, 8,  0 },
+    { "utf8",        1, 12, 2, 30 },
+    { NULL, 0, 0, 0, 0 },
+};
+
+// Two to four byte characters for the utf8 corpus
+static const char *const MB_CHARS[] = {
+    "\xc3\xa9", "\xc3\xbc", "\xc3\x9f", "\xd0\xb6", "\xd1\x8f",
+    "\xe6\x97\xa5", "\xe6\x9c\xac", "\xe8\xaa\x9e", "\xf0\x9f\x98\x80",
+};
+
+// Fill buf with the corpus.  A character that would not fit is replaced
+// by spaces so the utf8 corpus is always valid.
+static void fill_corpus(const corpus_t *c, char *buf, size_t len) {
+    size_t needle_at = len / 10 * 9;
+    bool planted = false;
+    size_t i = 0;
+
+    rng_seed(BENCH_SEED); // Same bytes on every run
+    while (i < len) {
+        if (!planted && i >= needle_at && i + strlen(NEEDLE) < len) {
+            memcpy(buf + i, NEEDLE, strlen(NEEDLE));
+            i += strlen(NEEDLE);
+            planted = true;
+        }
+        size_t wlen = rng_range(c->min_word, c->max_word);
+        for (size_t j = 0; j < wlen && i < len; j++) {
+            if ((int)(rng_next() % 100) < c->utf8_pct) {
+                const char *mb = MB_CHARS[rng_next() % (sizeof(MB_CHARS) / sizeof(MB_CHARS[0]))];
+                size_t n = strlen(mb);
+                if (i + n > len) {
+                    break;
+                }
+                memcpy(buf + i, mb, n);
+                i += n;
+            } else {
+                buf[i++] = 'a' + rng_next() % 26;
+            }
+        }
+        size_t slen = rng_range(1, c->max_spaces);
+        for (size_t j = 0; j < slen && i < len; j++) {
+            buf[i++] = SPACE_CHAR;
+        }
+    }
+    while (i < len) {
+        buf[i++] = SPACE_CHAR;
+    }
+}
+
+static int cmp_double(const void *a, const void *b) {
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// The operations, each runs once over the corpus.  sb holds the corpus
+// after setup_buff() and str_len its length.
+typedef struct bench_ctx {
+    const char *text;
+    size_t      len;
+    strbuf_t    sb;
+    size_t      str_len;
+} bench_ctx_t;
+
+static long op_setup_buff(bench_ctx_t *b) {
+    return setup_buff_n(&b->sb, b->text, b->len, BUFFER_SZ);
+}
+
+static long op_count_words(bench_ctx_t *b) {
+    return count_words(b->sb.data, b->sb.len, b->str_len);
+}
+
+static long op_reverse_string(bench_ctx_t *b) {
+    reverse_string(b->sb.data, b->str_len); // Runs alternate directions
+    return 0;
+}
+
+// The needle is replaced by itself, so the buffer is the same every run
+static long op_replace_substring(bench_ctx_t *b) {
+    return replace_substring(&b->sb, b->str_len, NEEDLE, NEEDLE, BUFFER_SZ);
+}
+
+static long op_print_words(bench_ctx_t *b) {
+    print_words_with_length(b->sb.data, b->sb.len, b->str_len);
+    return out_flush();
+}
+
+typedef struct bench_op {
+    const char *name;
+    long      (*fn)(bench_ctx_t *b);
+} bench_op_t;
+
+static const bench_op_t OPS[] = {
+    { "setup_buff",              op_setup_buff },
+    { "count_words",             op_count_words },
+    { "reverse_string",          op_reverse_string },
+    { "replace_substring",       op_replace_substring },
+    { "print_words_with_length", op_print_words },
+    { NULL, NULL },
+};
+
+// Time one operation, returns the median seconds and the best in *best
+static double time_op(const bench_op_t *op, bench_ctx_t *b, int reps, double *times, double *best) {
+    for (int r = 0; r < WARMUP_REPS; r++) {
+        op->fn(b);
+    }
+    for (int r = 0; r < reps; r++) {
+        double t0 = now_sec();
+        op->fn(b);
+        times[r] = now_sec() - t0;
+    }
+    qsort(times, reps, sizeof(*times), cmp_double);
+    *best = times[0];
+    return reps % 2 ? times[reps / 2] : (times[reps / 2 - 1] + times[reps / 2]) / 2;
+}
+
+static const corpus_t *find_corpus(const char *name) {
+    for (const corpus_t *c = CORPORA; c->name; c++) {
+        if (strcmp(c->name, name) == 0) {
+            return c;
+        }
+    }
+    return NULL;
+}
+
+// -g: write one corpus to stdout, for timing the stringfun program itself
+static int write_corpus(const char *name, size_t len) {
+    const corpus_t *c = find_corpus(name);
+    char *buf = malloc(len);
+
+    if (c == NULL || buf == NULL) {
+        fprintf(stderr, "Error: %s\n", c ? "Out of memory" : "Unknown corpus");
+        free(buf);
+        return 1;
+    }
+    fill_corpus(c, buf, len);
+    int rc = fwrite(buf, 1, len, stdout) == len ? 0 : 2;
+    free(buf);
+    return rc;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc > 2 && strcmp(argv[1], "-g") == 0) {
+        size_t size_mb = argc > 3 ? strtoul(argv[3], NULL, 10) : DEF_SIZE_MB;
+        return write_corpus(argv[2], size_mb * 1024 * 1024);
+    }
+
+    size_t size_mb = argc > 1 ? strtoul(argv[1], NULL, 10) : DEF_SIZE_MB;
+    int reps = argc > 2 ? atoi(argv[2]) : DEF_REPS;
+    size_t len = size_mb * 1024 * 1024;
+
+    if (len == 0 || reps <= 0) {
+        fprintf(stderr, "usage: %s [size_mb] [reps]\n", argv[0]);
+        fprintf(stderr, "       %s -g corpus [size_mb]\n", argv[0]);
+        return 1;
+    }
+
+    bench_ctx_t b = { .len = len };
+    char *text = malloc(len);
+    double *times = malloc(reps * sizeof(*times));
+    if (text == NULL || times == NULL || sb_init(&b.sb, len) != SB_OK) {
+        fprintf(stderr, "Error: Failed to allocate %zu MB\n", size_mb);
+        return 99;
+    }
+    b.text = text;
+
+    // The word listing goes to /dev/null, the CSV to the real stdout
+    fflush(stdout);
+    int saved = dup(STDOUT_FILENO);
+    int null_fd = open("/dev/null", O_WRONLY);
+    if (saved < 0 || null_fd < 0) {
+        perror("sf_bench");
+        return 1;
+    }
+
+    printf("corpus,op,bytes,reps,ns_per_byte,gb_per_s,best_gb_per_s\n");
+    for (const corpus_t *c = CORPORA; c->name; c++) {
+        fill_corpus(c, text, len);
+        for (const bench_op_t *op = OPS; op->name; op++) {
+            b.str_len = setup_buff_n(&b.sb, text, len, BUFFER_SZ);
+
+            double best;
+            fflush(stdout);
+            dup2(null_fd, STDOUT_FILENO);
+            double med = time_op(op, &b, reps, times, &best);
+            dup2(saved, STDOUT_FILENO);
+
+            // setup_buff reads the corpus, the others the squeezed string
+            size_t bytes = op->fn == op_setup_buff ? len : b.str_len;
+            printf("%s,%s,%zu,%d,%.4f,%.3f,%.3f\n", c->name, op->name, bytes, reps,
+                   med * 1e9 / bytes, bytes / med / 1e9, bytes / best / 1e9);
+        }
+    }
+
+    close(saved);
+    close(null_fd);
+    sb_free(&b.sb);
+    free(times);
+    free(text);
+    return 0;
+}
@@ -0,0 +1,105 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "bench_util.h"
+#include "sfpar.h"
+#include "sfsimd.h"
+
+// Word counting microbenchmark.  Builds a large random text and runs every
+// kernel the CPU supports over it, checking each one against the scalar
+// reference (whole buffer and odd sized chunks) before reporting GB/s.
+// Then wc_parallel() is timed with 1, 2, 4, ... threads up to the number of
+// online CPUs to show how the -j mode scales.
+//
+//   usage: wc_bench [size_mb] [reps]
+
+#define DEF_SIZE_MB     256
+#define DEF_REPS        5
+#define CHUNK_CHECK_SZ  4093    // odd size so chunks split words and vectors
+#define TEXT_SEPS       "    \t\n  \r \v\f" // mostly spaces, the odd tab or newline
+
+static long count_chunked(wc_kernel_fn fn, const char *buf, size_t len) {
+    bool in_word = false;
+    long words = 0;
+
+    for (size_t off = 0; off < len; off += CHUNK_CHECK_SZ) {
+        size_t n = len - off < CHUNK_CHECK_SZ ? len - off : CHUNK_CHECK_SZ;
+        words += fn(buf + off, n, &in_word);
+    }
+    return words;
+}
+
+int main(int argc, char *argv[]) {
+    size_t size_mb = argc > 1 ? strtoul(argv[1], NULL, 10) : DEF_SIZE_MB;
+    int reps = argc > 2 ? atoi(argv[2]) : DEF_REPS;
+    size_t len = size_mb * 1024 * 1024;
+    int rc = 0;
+
+    if (len == 0 || reps <= 0) {
+        fprintf(stderr, "usage: %s [size_mb] [reps]\n", argv[0]);
+        return 1;
+    }
+    char *buf = malloc(len);
+    if (buf == NULL) {
+        fprintf(stderr, "Error: Failed to allocate %zu MB\n", size_mb);
+        return 99;
+    }
+    fill_text(buf, len, TEXT_SEPS, true);
+
+    bool in_word = false;
+    long expect = wc_count_scalar(buf, len, &in_word);
+
+    printf("%-8s %12s %10s\n", "kernel", "words", "GB/s");
+    for (const sf_kernel_t *k = WC_KERNELS; k->name; k++) {
+        if (!k->supported()) {
+            printf("%-8s %12s %10s\n", k->name, "-", "n/a");
+            continue;
+        }
+
+        long words = 0;
+        double best = 0;
+        for (int r = 0; r < reps; r++) {
+            in_word = false;
+            double t0 = now_sec();
+            words = k->fn(buf, len, &in_word);
+            double t = now_sec() - t0;
+            if (r == 0 || t < best) {
+                best = t;
+            }
+        }
+
+        bool ok = words == expect && count_chunked(k->fn, buf, len) == expect;
+        printf("%-8s %12ld %10.2f%s\n", k->name, words, len / best / 1e9,
+               ok ? "" : "  MISMATCH");
+        if (!ok) {
+            rc = 1;
+        }
+    }
+
+    long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+    printf("\n%-8s %12s %10s\n", "threads", "words", "GB/s");
+    for (int jobs = 1; jobs <= ncpu || jobs == 1; jobs *= 2) {
+        wc_state_t st = {0, false};
+        double best = 0;
+        for (int r = 0; r < reps; r++) {
+            st = (wc_state_t){0, false};
+            double t0 = now_sec();
+            wc_parallel(&st, buf, len, jobs);
+            double t = now_sec() - t0;
+            if (r == 0 || t < best) {
+                best = t;
+            }
+        }
+        printf("%-8d %12ld %10.2f%s\n", jobs, st.words, len / best / 1e9,
+               st.words == expect ? "" : "  MISMATCH");
+        if (st.words != expect) {
+            rc = 1;
+        }
+    }
+
+    free(buf);
+    return rc;
+}
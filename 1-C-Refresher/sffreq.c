@@ -0,0 +1,224 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sflib.h"
+#include "sffreq.h"
+#include "sfout.h"
+
+char *arena_alloc(arena_t *a, size_t n) {
+    arena_block_t *b = a->head;
+
+    if (b == NULL || b->cap - b->used < n) {
+        size_t cap = n > ARENA_BLOCK_SZ ? n : ARENA_BLOCK_SZ;
+        b = malloc(sizeof(*b) + cap);
+        if (b == NULL) {
+            return NULL;
+        }
+        b->next = a->head;
+        b->used = 0;
+        b->cap = cap;
+        a->head = b;
+    }
+    char *p = b->data + b->used;
+    b->used += n;
+    return p;
+}
+
+void arena_free(arena_t *a) {
+    while (a->head) {
+        arena_block_t *next = a->head->next;
+        free(a->head);
+        a->head = next;
+    }
+}
+
+// FNV-1a
+static uint32_t freq_hash(const char *word, size_t len) {
+    uint32_t h = 2166136261u;
+
+    for (size_t i = 0; i < len; i++) {
+        h ^= (unsigned char)word[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+int freq_table_init(freq_table_t *t) {
+    t->slot = calloc(FREQ_MIN_CAP, sizeof(*t->slot));
+    t->cap = FREQ_MIN_CAP;
+    t->used = 0;
+    t->arena.head = NULL;
+    return t->slot ? SF_OK : SF_ERR_MEM;
+}
+
+// Double the table, rehashing with the stored hashes
+static int freq_grow(freq_table_t *t) {
+    size_t cap = t->cap * 2;
+    freq_entry_t *slot = calloc(cap, sizeof(*slot));
+
+    if (slot == NULL) {
+        return SF_ERR_MEM;
+    }
+    for (size_t i = 0; i < t->cap; i++) {
+        if (t->slot[i].word) {
+            size_t j = t->slot[i].hash & (cap - 1);
+            while (slot[j].word) {
+                j = (j + 1) & (cap - 1);
+            }
+            slot[j] = t->slot[i];
+        }
+    }
+    free(t->slot);
+    t->slot = slot;
+    t->cap = cap;
+    return SF_OK;
+}
+
+// Add count to a word, interning it in the arena the first time it is seen
+int freq_add(freq_table_t *t, const char *word, size_t len, long count) {
+    uint32_t h = freq_hash(word, len);
+    size_t i = h & (t->cap - 1);
+
+    while (t->slot[i].word) {
+        freq_entry_t *e = &t->slot[i];
+        if (e->hash == h && e->len == len && memcmp(e->word, word, len) == 0) {
+            e->count += count;
+            return SF_OK;
+        }
+        i = (i + 1) & (t->cap - 1);
+    }
+
+    char *copy = arena_alloc(&t->arena, len);
+    if (copy == NULL) {
+        return SF_ERR_MEM;
+    }
+    memcpy(copy, word, len);
+    t->slot[i] = (freq_entry_t){ copy, len, h, count };
+    if (++t->used * 4 > t->cap * 3) {
+        return freq_grow(t);
+    }
+    return SF_OK;
+}
+
+// Add every word of src to dst
+int freq_merge(freq_table_t *dst, const freq_table_t *src) {
+    for (size_t i = 0; i < src->cap; i++) {
+        const freq_entry_t *e = &src->slot[i];
+        if (e->word && freq_add(dst, e->word, e->len, e->count) != SF_OK) {
+            return SF_ERR_MEM;
+        }
+    }
+    return SF_OK;
+}
+
+void freq_table_free(freq_table_t *t) {
+    free(t->slot);
+    arena_free(&t->arena);
+    t->slot = NULL;
+    t->cap = t->used = 0;
+}
+
+// Highest count first, ties in byte order so the output is stable
+static int freq_cmp(const void *a, const void *b) {
+    const freq_entry_t *x = a;
+    const freq_entry_t *y = b;
+
+    if (x->count != y->count) {
+        return x->count > y->count ? -1 : 1;
+    }
+    size_t n = x->len < y->len ? x->len : y->len;
+    int c = memcmp(x->word, y->word, n);
+    return c ? c : (x->len > y->len) - (x->len < y->len);
+}
+
+// Print the top words like uniq -c does: count, a space, the word
+int freq_print_top(const freq_table_t *t, long top) {
+    freq_entry_t *list = malloc((t->used ? t->used : 1) * sizeof(*list));
+    size_t n = 0;
+
+    if (list == NULL) {
+        return SF_ERR_MEM;
+    }
+    for (size_t i = 0; i < t->cap; i++) {
+        if (t->slot[i].word) {
+            list[n++] = t->slot[i];
+        }
+    }
+    qsort(list, n, sizeof(*list), freq_cmp);
+    for (size_t i = 0; i < n && (long)i < top; i++) {
+        out_long_width(list[i].count, 7);
+        out_putc(SPACE_CHAR);
+        out_write(list[i].word, list[i].len);
+        out_putc('\n');
+    }
+    free(list);
+    return SF_OK;
+}
+
+int freq_begin(freq_state_t *fs) {
+    memset(fs, 0, sizeof(*fs)); // Safe to freq_free() even if this fails
+    if (freq_table_init(&fs->tab) != SF_OK) {
+        return SF_ERR_MEM;
+    }
+    if (sb_init(&fs->partial, SB_MIN_CAP) != SB_OK) {
+        freq_table_free(&fs->tab);
+        return SF_ERR_MEM;
+    }
+    return SF_OK;
+}
+
+// Add the words of a chunk.  Words are hashed straight from the chunk, only
+// one cut off by the end of the chunk is copied to partial.
+int freq_feed(freq_state_t *fs, const char *data, size_t len) {
+    size_t i = 0;
+
+    if (fs->partial.len > 0) {
+        // Finish the word left over from the previous chunk
+        while (i < len && !IS_WORD_SEP(data[i])) {
+            i++;
+        }
+        if (sb_append(&fs->partial, data, i) != SB_OK) {
+            return SF_ERR_MEM;
+        }
+        if (i == len) {
+            return SF_OK;
+        }
+        if (freq_add(&fs->tab, fs->partial.data, fs->partial.len, 1) != SF_OK) {
+            return SF_ERR_MEM;
+        }
+        fs->partial.len = 0;
+    }
+
+    while (i < len) {
+        while (i < len && IS_WORD_SEP(data[i])) {
+            i++;
+        }
+        size_t start = i;
+        while (i < len && !IS_WORD_SEP(data[i])) {
+            i++;
+        }
+        if (i == len) {
+            return sb_append(&fs->partial, data + start, i - start) == SB_OK ? SF_OK : SF_ERR_MEM;
+        }
+        if (freq_add(&fs->tab, data + start, i - start, 1) != SF_OK) {
+            return SF_ERR_MEM;
+        }
+    }
+    return SF_OK;
+}
+
+// Count the last word, if the input did not end with a separator
+int freq_end(freq_state_t *fs) {
+    if (fs->partial.len > 0) {
+        int rc = freq_add(&fs->tab, fs->partial.data, fs->partial.len, 1);
+        fs->partial.len = 0;
+        return rc;
+    }
+    return SF_OK;
+}
+
+void freq_free(freq_state_t *fs) {
+    freq_table_free(&fs->tab);
+    sb_free(&fs->partial);
+}
@@ -0,0 +1,66 @@
+#ifndef __SFFREQ_H__
+#define __SFFREQ_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "strbuf.h"
+
+#define FREQ_DEF_TOP    10          // -F without a count
+#define FREQ_MIN_CAP    1024        // starting table size, a power of two
+#define ARENA_BLOCK_SZ  (1024 * 1024)
+
+// Bump allocator for the words.  Memory is handed out from the newest
+// block and only released all at once, so interning a word never calls
+// malloc except when a block fills up.
+typedef struct arena_block {
+    struct arena_block *next;
+    size_t              used;
+    size_t              cap;
+    char                data[];
+} arena_block_t;
+
+typedef struct arena {
+    arena_block_t *head;
+} arena_t;
+
+char *arena_alloc(arena_t *a, size_t n);
+void  arena_free(arena_t *a);
+
+// Open addressing hash table with linear probing, keyed by word.  A slot
+// with word == NULL is empty.  The table doubles at 3/4 full, the words
+// stay where they are in the arena.
+typedef struct freq_entry {
+    const char *word;
+    uint32_t    len;
+    uint32_t    hash;
+    long        count;
+} freq_entry_t;
+
+typedef struct freq_table {
+    freq_entry_t *slot;
+    size_t        cap;
+    size_t        used;
+    arena_t       arena;
+} freq_table_t;
+
+int  freq_table_init(freq_table_t *t);
+int  freq_add(freq_table_t *t, const char *word, size_t len, long count);
+int  freq_merge(freq_table_t *dst, const freq_table_t *src);
+void freq_table_free(freq_table_t *t);
+int  freq_print_top(const freq_table_t *t, long top);
+
+// Chunk-fed tokenizer, same word rules as count_words().  partial holds a
+// word that runs off the end of a chunk.
+typedef struct freq_state {
+    freq_table_t tab;
+    strbuf_t     partial;
+} freq_state_t;
+
+int  freq_begin(freq_state_t *fs);
+int  freq_feed(freq_state_t *fs, const char *data, size_t len);
+int  freq_end(freq_state_t *fs);
+void freq_free(freq_state_t *fs);
+
+#endif
@@ -0,0 +1,259 @@
+#define _GNU_SOURCE // memmem()
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "sflib.h"
+#include "sfout.h"
+#include "sfsimd.h"
+
+// Setup buffer with padding.  Runs of spaces collapse to one space, leading
+// and trailing spaces are dropped, and the result is padded with PAD_CHAR up
+// to min_len.  Returns the length of the string without the padding.
+ssize_t setup_buff(strbuf_t *sb, const char *user_str, size_t min_len) {
+    return setup_buff_n(sb, user_str, strlen(user_str), min_len);
+}
+
+// setup_buff() for a string that is not NUL terminated, such as a line of
+// batch input
+ssize_t setup_buff_n(strbuf_t *sb, const char *user_str, size_t in_len, size_t min_len) {
+    bool at_space = true; // Tracks consecutive spaces
+
+    // The collapsed string is never longer than the input
+    sb_clear(sb);
+    if (sb_reserve(sb, in_len > min_len ? in_len : min_len) != SB_OK) {
+        return SF_ERR_MEM;
+    }
+
+    // Spaces are squeezed by the fastest kernel in sfsimd.c the CPU supports
+    size_t str_len = sqz_kernel()(sb->data, user_str, in_len, &at_space);
+
+    // Handle trailing spaces
+    if (str_len > 0 && sb->data[str_len - 1] == SPACE_CHAR) {
+        str_len--;
+    }
+
+    // Pad the remaining buffer with '.', one memset
+    sb->len = str_len;
+    if (str_len < min_len) {
+        sb_fill(sb, PAD_CHAR, min_len - str_len); // Capacity reserved above
+    }
+
+    return str_len;
+}
+
+// Print the buffer
+void print_buff(strbuf_t *sb) {
+    out_str("Buffer:  [");
+    out_write(sb->data, sb->len);
+    out_str("]\n");
+}
+
+// Count words in a chunk, continuing the word state of the previous chunk.
+// The counting is done by the fastest kernel in sfsimd.c the CPU supports.
+void wc_feed(wc_state_t *st, const char *data, size_t len) {
+    st->words += wc_kernel()(data, len, &st->in_word);
+}
+
+// Count words in the buffer
+long count_words(const char *buff, size_t len, size_t str_len) {
+    (void)len; // Suppress unused parameter warning
+    wc_state_t st = {0, false};
+
+    wc_feed(&st, buff, str_len);
+    return st.words;
+}
+
+// Reverse the string in place.  Only the first str_len bytes are touched, so
+// the padding stays at the end of the buffer.
+void reverse_string(char *buff, size_t str_len) {
+    rev_kernel()(buff, str_len); // Vector swap from both ends
+    move_pad_to_end(buff, str_len);
+}
+
+// Dots inside the string move to the end with the padding, compacting the
+// other characters forward in place.  Most strings have none.
+void move_pad_to_end(char *buff, size_t str_len) {
+    char *dot = memchr(buff, PAD_CHAR, str_len);
+    if (dot == NULL) {
+        return;
+    }
+    size_t keep = dot - buff;
+    for (size_t i = keep; i < str_len; i++) {
+        if (buff[i] != PAD_CHAR) {
+            buff[keep++] = buff[i];
+        }
+    }
+    memset(buff + keep, PAD_CHAR, str_len - keep);
+}
+
+// Reverse the order of the words, keeping each word readable: the whole
+// string is reversed and then every word and every run of separators is
+// reversed back.  Only the first str_len bytes are touched.
+void reverse_words(char *buff, size_t str_len) {
+    rev_kernel_fn rev = rev_kernel();
+    size_t i = 0;
+
+    rev(buff, str_len);
+    while (i < str_len) {
+        size_t run = i;
+        bool sep = IS_WORD_SEP(buff[i]);
+        while (run < str_len && IS_WORD_SEP(buff[run]) == sep) {
+            run++;
+        }
+        rev(buff + i, run - i);
+        i = run;
+    }
+}
+
+// Start a word listing
+void words_begin(words_state_t *ws, bool skip_pad) {
+    ws->word_count = 0;
+    ws->char_count = 0;
+    ws->skip_pad = skip_pad;
+    out_str("Word Print\n----------\n");
+}
+
+// Print the length of a finished word and move to the next line
+static void words_finish(words_state_t *ws) {
+    out_str(" (");
+    out_long(ws->char_count);
+    out_str(")\n");
+    ws->char_count = 0; // Reset the character counter
+    ws->word_count++;
+}
+
+// Print the words of a chunk, a word can continue into the next chunk.
+// Characters are written a run at a time rather than one by one.
+void words_feed(words_state_t *ws, const char *data, size_t len) {
+    size_t i = 0;
+
+    while (i < len) {
+        char c = data[i];
+        if (IS_WORD_SEP(c)) {
+            if (ws->char_count > 0) {
+                words_finish(ws);
+            }
+            i++;
+        } else if (c == PAD_CHAR && ws->skip_pad) {
+            i++; // Ignore padding dots
+        } else {
+            size_t run = i + 1;
+            while (run < len && !IS_WORD_SEP(data[run]) &&
+                   (data[run] != PAD_CHAR || !ws->skip_pad)) {
+                run++;
+            }
+            if (ws->char_count == 0) {
+                out_long(ws->word_count + 1); // Word number before the first character
+                out_str(". ");
+            }
+            out_write(data + i, run - i);
+            ws->char_count += run - i;
+            i = run;
+        }
+    }
+}
+
+// Finish the listing, printing the length of the last word
+void words_end(words_state_t *ws) {
+    if (ws->char_count > 0) {
+        words_finish(ws); // Print the length of the last word
+    }
+}
+
+// Print words with their lengths
+void print_words_with_length(const char *buff, size_t len, size_t str_len) {
+    (void)len; // Suppress unused parameter warning
+    words_state_t ws;
+
+    words_begin(&ws, true);
+    words_feed(&ws, buff, str_len);
+    words_end(&ws);
+}
+
+// Replace the first occurrence of old_sub in the string with new_sub.  The
+// buffer grows if the result is longer than its capacity and the result is
+// re-padded with PAD_CHAR up to min_len.  Returns the new string length.
+ssize_t replace_substring(strbuf_t *sb, size_t str_len, const char *old_sub,
+                          const char *new_sub, size_t min_len) {
+    size_t old_len = strlen(old_sub);
+    size_t new_len = strlen(new_sub);
+    char *pos = NULL;
+
+    // Find the first occurrence of old_sub in the string
+    if (old_len > 0) {
+        pos = memmem(sb->data, str_len, old_sub, old_len);
+    }
+
+    if (!pos) {
+        return SF_ERR_NOT_FOUND; // Substring not found
+    }
+
+    size_t at = pos - sb->data;
+    size_t tail = str_len - at - old_len;
+    size_t res_len = str_len - old_len + new_len;
+
+    if (sb_reserve(sb, res_len > min_len ? res_len : min_len) != SB_OK) {
+        return SF_ERR_MEM;
+    }
+
+    // Shift the text after the old substring, then copy the new one in
+    memmove(sb->data + at + new_len, sb->data + at + old_len, tail);
+    memcpy(sb->data + at, new_sub, new_len);
+
+    // Re-pad the buffer
+    sb->len = res_len;
+    if (res_len < min_len) {
+        sb_fill(sb, PAD_CHAR, min_len - res_len);
+    }
+
+    return res_len;
+}
+
+/*
+ * replace_all
+ *   Replaces every non-overlapping occurrence of old_sub, scanning left to
+ *   right.  The matches are found with memmem (Two-Way in glibc, linear in
+ *   the worst case and sublinear on typical text) and the result is built
+ *   in one pass into a second buffer, so each input byte is copied once no
+ *   matter how many matches there are or how the lengths differ.  The
+ *   result is re-padded to min_len like replace_substring().
+ *   Returns the new string length, SF_ERR_NOT_FOUND or SF_ERR_MEM.
+ */
+ssize_t replace_all(strbuf_t *sb, size_t str_len, const char *old_sub,
+                    const char *new_sub, size_t min_len) {
+    size_t old_len = strlen(old_sub);
+    size_t new_len = strlen(new_sub);
+    const char *src = sb->data;
+    const char *end = sb->data + str_len;
+    const char *hit;
+    strbuf_t out;
+
+    if (old_len == 0 || (hit = memmem(src, str_len, old_sub, old_len)) == NULL) {
+        return SF_ERR_NOT_FOUND;
+    }
+    if (sb_init(&out, str_len > min_len ? str_len : min_len) != SB_OK) {
+        return SF_ERR_MEM;
+    }
+
+    do {
+        if (sb_append(&out, src, hit - src) != SB_OK ||
+            sb_append(&out, new_sub, new_len) != SB_OK) {
+            sb_free(&out);
+            return SF_ERR_MEM;
+        }
+        src = hit + old_len;
+    } while ((hit = memmem(src, end - src, old_sub, old_len)) != NULL);
+
+    size_t res_len = out.len + (end - src);
+    if (sb_append(&out, src, end - src) != SB_OK ||
+        (res_len < min_len && sb_fill(&out, PAD_CHAR, min_len - res_len) != SB_OK)) {
+        sb_free(&out);
+        return SF_ERR_MEM;
+    }
+
+    sb_free(sb);
+    *sb = out; // The result replaces the old buffer
+    return res_len;
+}
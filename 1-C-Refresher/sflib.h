@@ -0,0 +1,63 @@
+#ifndef __SFLIB_H__
+#define __SFLIB_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+#include "strbuf.h"
+
+// Strings shorter than BUFFER_SZ are padded with PAD_CHAR up to BUFFER_SZ so
+// the classic 50 byte output stays the same.  Longer strings grow the
+// buffer instead of being rejected.
+#define BUFFER_SZ   50
+#define PAD_CHAR    '.'
+#define SPACE_CHAR  ' '
+
+// Word separators for counting and printing words: ' ' plus the other ASCII
+// whitespace characters, the same set wc -w uses
+#define IS_WORD_SEP(c)  ((c) == SPACE_CHAR || (unsigned char)((c) - '\t') < 5)
+
+// Return codes
+#define SF_OK              0
+#define SF_ERR_NOT_FOUND  -1
+#define SF_ERR_MEM        -2
+#define SF_ERR_IO         -3
+#define SF_ERR_FORMAT     -4
+
+// Word counting state that can be fed one chunk at a time, in_word carries
+// a word that straddles two chunks
+typedef struct wc_state {
+    long words;
+    bool in_word;
+} wc_state_t;
+
+// Word printing state, same idea as wc_state_t.  skip_pad ignores PAD_CHAR
+// the way the padded buffer needs, streamed input prints it as text.
+typedef struct words_state {
+    long   word_count;  // words finished so far
+    size_t char_count;  // characters printed for the current word
+    bool   skip_pad;
+} words_state_t;
+
+// Buffer operations, see sflib.c
+ssize_t setup_buff(strbuf_t *sb, const char *user_str, size_t min_len);
+ssize_t setup_buff_n(strbuf_t *sb, const char *user_str, size_t in_len, size_t min_len);
+void    print_buff(strbuf_t *sb);
+long    count_words(const char *buff, size_t len, size_t str_len);
+void    reverse_string(char *buff, size_t str_len);
+void    move_pad_to_end(char *buff, size_t str_len);
+void    reverse_words(char *buff, size_t str_len);
+void    print_words_with_length(const char *buff, size_t len, size_t str_len);
+ssize_t replace_substring(strbuf_t *sb, size_t str_len, const char *old_sub,
+                          const char *new_sub, size_t min_len);
+ssize_t replace_all(strbuf_t *sb, size_t str_len, const char *old_sub,
+                    const char *new_sub, size_t min_len);
+
+// Chunked versions used by the buffer operations and the streaming mode
+void    wc_feed(wc_state_t *st, const char *data, size_t len);
+void    words_begin(words_state_t *ws, bool skip_pad);
+void    words_feed(words_state_t *ws, const char *data, size_t len);
+void    words_end(words_state_t *ws);
+
+#endif
@@ -0,0 +1,357 @@
+#define _GNU_SOURCE // memmem()
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sflib.h"
+#include "sfmulti.h"
+#include "sfout.h"
+
+// Read the whole rules file into rs->text
+static int rules_read(rules_t *rs, const char *path) {
+    char block[64 * 1024];
+    size_t n;
+    FILE *fp = fopen(path, "r");
+
+    if (fp == NULL) {
+        return SF_ERR_IO;
+    }
+    while ((n = fread(block, 1, sizeof(block), fp)) > 0) {
+        if (sb_append(&rs->text, block, n) != SB_OK) {
+            fclose(fp);
+            return SF_ERR_MEM;
+        }
+    }
+    int rc = ferror(fp) ? SF_ERR_IO : SF_OK;
+    fclose(fp);
+    return rc;
+}
+
+// Split the text into rules, the strings stay in the text buffer
+static int rules_parse(rules_t *rs, long *bad_line) {
+    size_t cap = 0;
+    char *p = rs->text.data;
+    char *end = rs->text.data + rs->text.len;
+    long line_no = 0;
+
+    while (p < end) {
+        char *nl = memchr(p, '\n', end - p);
+        char *eol = nl ? nl : end;
+        char *next = nl ? nl + 1 : end;
+        line_no++;
+
+        if (eol > p && eol[-1] == '\r') {
+            eol--; // Rules files written on Windows
+        }
+        if (eol == p || *p == SF_RULE_COMMENT) {
+            p = next;
+            continue;
+        }
+
+        char *sep = memmem(p, eol - p, SF_RULE_SEP, strlen(SF_RULE_SEP));
+        if (sep == NULL || sep == p) {
+            *bad_line = line_no; // No separator, or nothing to replace
+            return SF_ERR_FORMAT;
+        }
+
+        if (rs->nrules == cap) {
+            cap = cap ? 2 * cap : 16;
+            sf_rule_t *grown = realloc(rs->rule, cap * sizeof(*grown));
+            if (grown == NULL) {
+                return SF_ERR_MEM;
+            }
+            rs->rule = grown;
+        }
+        sf_rule_t *r = &rs->rule[rs->nrules++];
+        r->old_sub = p;
+        r->old_len = sep - p;
+        r->new_sub = sep + strlen(SF_RULE_SEP);
+        r->new_len = eol - r->new_sub;
+        p = next;
+    }
+    return SF_OK;
+}
+
+// Build the automaton: a trie of the old strings, then a breadth first pass
+// that fills in the missing transitions from the failure links and copies
+// the longest match of each failure state into states with none of their own
+static int rules_build(rules_t *rs) {
+    size_t max_states = 1;
+    for (size_t i = 0; i < rs->nrules; i++) {
+        max_states += rs->rule[i].old_len;
+    }
+
+    rs->next = malloc(max_states * sizeof(*rs->next));
+    rs->depth = calloc(max_states, sizeof(*rs->depth));
+    rs->out_len = calloc(max_states, sizeof(*rs->out_len));
+    rs->out_rule = calloc(max_states, sizeof(*rs->out_rule));
+    uint32_t *fail = malloc(max_states * sizeof(*fail));
+    uint32_t *queue = malloc(max_states * sizeof(*queue));
+    if (!rs->next || !rs->depth || !rs->out_len || !rs->out_rule || !fail || !queue) {
+        free(fail);
+        free(queue);
+        return SF_ERR_MEM;
+    }
+
+    memset(rs->next[0], -1, sizeof(rs->next[0]));
+    rs->nstates = 1;
+    for (size_t i = 0; i < rs->nrules; i++) {
+        const sf_rule_t *r = &rs->rule[i];
+        int32_t s = 0;
+        for (size_t j = 0; j < r->old_len; j++) {
+            unsigned char c = r->old_sub[j];
+            if (rs->next[s][c] < 0) {
+                int32_t t = rs->nstates++;
+                memset(rs->next[t], -1, sizeof(rs->next[t]));
+                rs->depth[t] = rs->depth[s] + 1;
+                rs->next[s][c] = t;
+            }
+            s = rs->next[s][c];
+        }
+        if (rs->out_len[s] == 0) {
+            rs->out_len[s] = r->old_len; // First rule for this string wins
+            rs->out_rule[s] = i;
+        }
+    }
+
+    size_t head = 0, tail = 0;
+    for (int c = 0; c < 256; c++) {
+        int32_t v = rs->next[0][c];
+        if (v < 0) {
+            rs->next[0][c] = 0;
+        } else {
+            fail[v] = 0;
+            queue[tail++] = v;
+        }
+    }
+    while (head < tail) {
+        uint32_t u = queue[head++];
+        for (int c = 0; c < 256; c++) {
+            int32_t v = rs->next[u][c];
+            if (v < 0) {
+                rs->next[u][c] = rs->next[fail[u]][c];
+                continue;
+            }
+            fail[v] = rs->next[fail[u]][c];
+            if (rs->out_len[v] == 0) {
+                rs->out_len[v] = rs->out_len[fail[v]];
+                rs->out_rule[v] = rs->out_rule[fail[v]];
+            }
+            queue[tail++] = v;
+        }
+    }
+
+    free(fail);
+    free(queue);
+    return SF_OK;
+}
+
+/*
+ * rules_load
+ *   Loads a rules file and builds its automaton.  The automaton has one
+ *   state per distinct prefix of the old strings, so its size follows the
+ *   total length of the rules, and matching costs the same however many
+ *   rules there are.
+ *   Returns SF_OK, SF_ERR_IO (see errno), SF_ERR_MEM, or SF_ERR_FORMAT with
+ *   the offending line number in *bad_line.
+ */
+int rules_load(rules_t *rs, const char *path, long *bad_line) {
+    int rc;
+
+    memset(rs, 0, sizeof(*rs));
+    if (sb_init(&rs->text, SB_MIN_CAP) != SB_OK) {
+        return SF_ERR_MEM;
+    }
+    if ((rc = rules_read(rs, path)) != SF_OK ||
+        (rc = rules_parse(rs, bad_line)) != SF_OK ||
+        (rc = rules_build(rs)) != SF_OK) {
+        rules_free(rs);
+    }
+    return rc;
+}
+
+void rules_free(rules_t *rs) {
+    sb_free(&rs->text);
+    free(rs->rule);
+    free(rs->next);
+    free(rs->depth);
+    free(rs->out_len);
+    free(rs->out_rule);
+    memset(rs, 0, sizeof(*rs));
+}
+
+int multi_begin(multi_state_t *ms, const rules_t *rs, strbuf_t *out) {
+    memset(ms, 0, sizeof(*ms));
+    ms->rs = rs;
+    ms->out = out;
+    return sb_init(&ms->pend, SB_MIN_CAP) == SB_OK ? SF_OK : SF_ERR_MEM;
+}
+
+static int multi_write(multi_state_t *ms, const char *p, size_t n) {
+    if (ms->out) {
+        return sb_append(ms->out, p, n) == SB_OK ? SF_OK : SF_ERR_MEM;
+    }
+    out_write(p, n);
+    return SF_OK;
+}
+
+// Write input [from, to), which may start in pend and end in the chunk
+// that begins at offset base
+static int multi_emit(multi_state_t *ms, const char *chunk, uint64_t base,
+                      uint64_t from, uint64_t to) {
+    if (from < base) {
+        uint64_t stop = to < base ? to : base;
+        if (multi_write(ms, ms->pend.data + (from - ms->pend_base), stop - from) != SF_OK) {
+            return SF_ERR_MEM;
+        }
+        from = stop;
+    }
+    if (from < to) {
+        return multi_write(ms, chunk + (from - base), to - from);
+    }
+    return SF_OK;
+}
+
+// Take the candidate: write the text before it and the replacement, then
+// scan again from its end
+static int multi_commit(multi_state_t *ms, const char *chunk, uint64_t base) {
+    const sf_rule_t *r = &ms->rs->rule[ms->cand_rule];
+
+    if (multi_emit(ms, chunk, base, ms->flushed, ms->cand_start) != SF_OK ||
+        multi_write(ms, r->new_sub, r->new_len) != SF_OK) {
+        return SF_ERR_MEM;
+    }
+    ms->flushed = ms->pos = ms->cand_start + ms->cand_len;
+    ms->state = 0;
+    ms->have_cand = false;
+    ms->matches++;
+    return SF_OK;
+}
+
+/*
+ * multi_scan
+ *   Runs the automaton over a chunk with leftmost-longest semantics.  The
+ *   longest rule ending at the current byte is the one that starts
+ *   furthest left, so it becomes the candidate if it starts before the
+ *   current one.  The candidate is taken once every partial match still
+ *   alive starts after it, at which point nothing can beat it; scanning
+ *   restarts at its end, so at most one pattern length is scanned twice per
+ *   match.  At the end of the input the last candidate is taken regardless.
+ */
+static int multi_scan(multi_state_t *ms, const char *chunk, size_t len, bool final) {
+    const rules_t *rs = ms->rs;
+    uint64_t base = ms->total;
+    uint64_t end = base + len;
+
+    for (;;) {
+        while (ms->pos < end) {
+            unsigned char c = (ms->pos >= base) ? chunk[ms->pos - base]
+                                                : ms->pend.data[ms->pos - ms->pend_base];
+            int32_t s = rs->next[ms->state][c];
+            ms->state = s;
+            ms->pos++;
+
+            if (rs->out_len[s]) {
+                uint64_t start = ms->pos - rs->out_len[s];
+                if (!ms->have_cand || start < ms->cand_start ||
+                    (start == ms->cand_start && rs->out_len[s] > ms->cand_len)) {
+                    ms->have_cand = true;
+                    ms->cand_start = start;
+                    ms->cand_len = rs->out_len[s];
+                    ms->cand_rule = rs->out_rule[s];
+                }
+            }
+            if (ms->have_cand && ms->pos - rs->depth[s] > ms->cand_start) {
+                if (multi_commit(ms, chunk, base) != SF_OK) {
+                    return SF_ERR_MEM;
+                }
+            }
+        }
+        if (!final || !ms->have_cand) {
+            break;
+        }
+        if (multi_commit(ms, chunk, base) != SF_OK) {
+            return SF_ERR_MEM;
+        }
+    }
+
+    // Write out everything that can no longer be part of a match: not the
+    // candidate, nor a partial match still alive, which may start before
+    // the candidate and replace it
+    uint64_t safe = end;
+    if (!final) {
+        safe = ms->pos - rs->depth[ms->state];
+        if (ms->have_cand && ms->cand_start < safe) {
+            safe = ms->cand_start;
+        }
+    }
+    if (multi_emit(ms, chunk, base, ms->flushed, safe) != SF_OK) {
+        return SF_ERR_MEM;
+    }
+    ms->flushed = safe;
+    if (final) {
+        return SF_OK;
+    }
+
+    // Keep the rest for the next chunk
+    if (ms->flushed >= base) {
+        ms->pend.len = 0;
+        if (sb_append(&ms->pend, chunk + (ms->flushed - base), end - ms->flushed) != SB_OK) {
+            return SF_ERR_MEM;
+        }
+    } else {
+        size_t drop = ms->flushed - ms->pend_base;
+        memmove(ms->pend.data, ms->pend.data + drop, ms->pend.len - drop);
+        ms->pend.len -= drop;
+        if (sb_append(&ms->pend, chunk, len) != SB_OK) {
+            return SF_ERR_MEM;
+        }
+    }
+    ms->pend_base = ms->flushed;
+    ms->total = end;
+    return SF_OK;
+}
+
+int multi_feed(multi_state_t *ms, const char *data, size_t len) {
+    return multi_scan(ms, data, len, false);
+}
+
+// Flush the input still held back and free the state
+int multi_end(multi_state_t *ms) {
+    int rc = multi_scan(ms, NULL, 0, true);
+    sb_free(&ms->pend);
+    return rc;
+}
+
+/*
+ * replace_rules
+ *   Buffer version of the -m mode: applies every rule to the string in one
+ *   pass and re-pads the result to min_len like replace_all().
+ *   Returns the new string length or SF_ERR_MEM.
+ */
+ssize_t replace_rules(strbuf_t *sb, size_t str_len, const rules_t *rs, size_t min_len) {
+    multi_state_t ms;
+    strbuf_t out;
+
+    if (sb_init(&out, str_len > min_len ? str_len : min_len) != SB_OK) {
+        return SF_ERR_MEM;
+    }
+    if (multi_begin(&ms, rs, &out) != SF_OK) {
+        sb_free(&out);
+        return SF_ERR_MEM;
+    }
+    int rc = multi_feed(&ms, sb->data, str_len);
+    if (multi_end(&ms) != SF_OK || rc != SF_OK) {
+        sb_free(&out);
+        return SF_ERR_MEM;
+    }
+
+    size_t res_len = out.len;
+    if (res_len < min_len && sb_fill(&out, PAD_CHAR, min_len - res_len) != SB_OK) {
+        sb_free(&out);
+        return SF_ERR_MEM;
+    }
+    sb_free(sb);
+    *sb = out;
+    return res_len;
+}
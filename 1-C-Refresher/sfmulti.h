@@ -0,0 +1,67 @@
+#ifndef __SFMULTI_H__
+#define __SFMULTI_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "strbuf.h"
+
+// Rules file for -m: one "old=>new" pair per line.  Blank lines and lines
+// starting with '#' are skipped, new may be empty.  When two rules have the
+// same old text the first one wins.
+#define SF_RULE_SEP     "=>"
+#define SF_RULE_COMMENT '#'
+
+typedef struct sf_rule {
+    const char *old_sub;    // both point into rules_t.text
+    size_t      old_len;
+    const char *new_sub;
+    size_t      new_len;
+} sf_rule_t;
+
+// Aho-Corasick automaton over all the old strings, with the goto and
+// failure functions folded into a full transition table so every input
+// byte costs one lookup.  For each state out_len is the length of the
+// longest rule that ends there (0 if none) and depth the length of the
+// longest pattern prefix the state stands for.
+typedef struct rules {
+    strbuf_t    text;       // the rules file, rules point into it
+    sf_rule_t  *rule;
+    size_t      nrules;
+    int32_t   (*next)[256];
+    uint32_t   *depth;
+    uint32_t   *out_len;
+    uint32_t   *out_rule;
+    size_t      nstates;
+} rules_t;
+
+int  rules_load(rules_t *rs, const char *path, long *bad_line);
+void rules_free(rules_t *rs);
+
+// Replacement state.  Bytes that may still be part of a match are kept in
+// pend between chunks, positions are absolute offsets into the input.
+typedef struct multi_state {
+    const rules_t *rs;
+    strbuf_t      *out;         // result buffer, NULL writes to stdout
+    strbuf_t       pend;        // input bytes [pend_base, total)
+    uint64_t       pend_base;
+    uint64_t       total;       // bytes fed so far
+    uint64_t       flushed;     // input before this is written out
+    uint64_t       pos;         // next byte to scan
+    int32_t        state;
+    bool           have_cand;   // leftmost-longest match not yet taken
+    uint64_t       cand_start;
+    uint32_t       cand_len;
+    uint32_t       cand_rule;
+    long           matches;
+} multi_state_t;
+
+int  multi_begin(multi_state_t *ms, const rules_t *rs, strbuf_t *out);
+int  multi_feed(multi_state_t *ms, const char *data, size_t len);
+int  multi_end(multi_state_t *ms);
+
+ssize_t replace_rules(strbuf_t *sb, size_t str_len, const rules_t *rs, size_t min_len);
+
+#endif
@@ -0,0 +1,92 @@
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "sflib.h"
+#include "sfout.h"
+
+static char out_buf[OUT_BUF_SZ];
+static size_t out_len = 0;
+static int out_err = 0;     // errno of the first failed write
+
+// Write it all, retrying short writes.  After an error output is dropped.
+static void out_raw(const char *p, size_t n) {
+    while (n > 0 && out_err == 0) {
+        ssize_t w = write(STDOUT_FILENO, p, n);
+        if (w < 0) {
+            if (errno != EINTR) {
+                out_err = errno;
+            }
+            continue;
+        }
+        p += w;
+        n -= w;
+    }
+}
+
+void out_write(const char *p, size_t n) {
+    if (n > OUT_BUF_SZ - out_len) {
+        out_raw(out_buf, out_len);
+        out_len = 0;
+        if (n >= OUT_BUF_SZ) {
+            out_raw(p, n); // Too big to be worth copying
+            return;
+        }
+    }
+    memcpy(out_buf + out_len, p, n);
+    out_len += n;
+}
+
+void out_putc(char c) {
+    if (out_len == OUT_BUF_SZ) {
+        out_raw(out_buf, out_len);
+        out_len = 0;
+    }
+    out_buf[out_len++] = c;
+}
+
+void out_str(const char *s) {
+    out_write(s, strlen(s));
+}
+
+// Decimal digits are produced back to front into a small buffer, then
+// padded on the left with spaces up to width like printf("%*ld")
+void out_long_width(long v, int width) {
+    char digits[24];
+    char *p = digits + sizeof(digits);
+    unsigned long u = (v < 0) ? -(unsigned long)v : (unsigned long)v;
+
+    do {
+        *--p = '0' + u % 10;
+        u /= 10;
+    } while (u);
+    if (v < 0) {
+        *--p = '-';
+    }
+
+    int len = digits + sizeof(digits) - p;
+    while (width-- > len) {
+        out_putc(SPACE_CHAR);
+    }
+    out_write(p, len);
+}
+
+void out_long(long v) {
+    out_long_width(v, 0);
+}
+
+// Write out the buffer.  Returns 0, or -1 with errno set if any write failed.
+int out_flush(void) {
+    out_raw(out_buf, out_len);
+    out_len = 0;
+    if (out_err) {
+        errno = out_err;
+        return -1;
+    }
+    return 0;
+}
+
+// For atexit()
+void out_exit(void) {
+    out_flush();
+}
@@ -0,0 +1,20 @@
+#ifndef __SFOUT_H__
+#define __SFOUT_H__
+
+#include <stddef.h>
+
+// Buffered writer for standard output.  Everything stringfun prints goes
+// through here into one large buffer that is handed to write() when it
+// fills up, so printing costs a memcpy instead of a stdio call per piece.
+// Only the main thread writes output.
+#define OUT_BUF_SZ  (256 * 1024)
+
+void out_write(const char *p, size_t n);
+void out_putc(char c);
+void out_str(const char *s);
+void out_long(long v);
+void out_long_width(long v, int width);
+int  out_flush(void);
+void out_exit(void);
+
+#endif
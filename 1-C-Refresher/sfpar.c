@@ -0,0 +1,175 @@
+#include <pthread.h>
+
+#include "sffreq.h"
+#include "sflib.h"
+#include "sfpar.h"
+#include "sfsimd.h"
+
+static void *wc_job_run(void *arg) {
+    wc_job_t *job = arg;
+
+    job->in_word = false;
+    job->words = job->count(job->data, job->len, &job->in_word);
+    return NULL;
+}
+
+/*
+ * wc_parallel
+ *   Counts the words in data[0..len) on up to jobs threads and adds them to
+ *   st, continuing its in_word state like wc_feed() does.  The input is
+ *   split in equal chunks which are counted as if each one started after a
+ *   separator.  A word that straddles a boundary is then counted twice, once
+ *   in each chunk, which is the case exactly when the last byte of one chunk
+ *   and the first byte of the next are both word characters.  The merge
+ *   subtracts one for every such boundary, so the total is exact.  A chunk
+ *   whose thread cannot be started is counted on the calling thread.
+ */
+void wc_parallel(wc_state_t *st, const char *data, size_t len, int jobs) {
+    wc_job_t job[SF_MAX_JOBS];
+    pthread_t tid[SF_MAX_JOBS];
+    bool started[SF_MAX_JOBS] = {false};
+
+    if (jobs > SF_MAX_JOBS) {
+        jobs = SF_MAX_JOBS;
+    }
+    if ((size_t)jobs > len / SF_PAR_MIN_CHUNK) {
+        jobs = len / SF_PAR_MIN_CHUNK; // Small inputs are not worth a thread
+    }
+    if (jobs <= 1) {
+        wc_feed(st, data, len);
+        return;
+    }
+
+    size_t per = len / jobs;
+    for (int i = 0; i < jobs; i++) {
+        job[i].count = wc_kernel(); // Chosen here, before any thread exists
+        job[i].data = data + i * per;
+        job[i].len = (i == jobs - 1) ? len - i * per : per;
+    }
+
+    // Chunk 0 runs on this thread while the others are counted
+    for (int i = 1; i < jobs; i++) {
+        started[i] = pthread_create(&tid[i], NULL, wc_job_run, &job[i]) == 0;
+    }
+    wc_job_run(&job[0]);
+    for (int i = 1; i < jobs; i++) {
+        if (started[i]) {
+            pthread_join(tid[i], NULL);
+        } else {
+            wc_job_run(&job[i]);
+        }
+    }
+
+    // Merge.  The previous state plays the part of the chunk before chunk 0.
+    bool prev_in_word = st->in_word;
+    long words = st->words;
+    for (int i = 0; i < jobs; i++) {
+        words += job[i].words;
+        if (prev_in_word && !IS_WORD_SEP(job[i].data[0])) {
+            words--; // Same word as the end of the previous chunk
+        }
+        prev_in_word = job[i].in_word;
+    }
+    st->words = words;
+    st->in_word = prev_in_word;
+}
+
+static void *freq_job_run(void *arg) {
+    freq_job_t *job = arg;
+
+    job->rc = freq_feed(job->fs, job->data, job->len);
+    return NULL;
+}
+
+/*
+ * freq_parallel
+ *   Adds the words in data[0..len) to fs on up to jobs threads.  The split
+ *   points are moved forward to just past a separator, so no word is cut in
+ *   two and the chunks can be tokenized independently, each into its own
+ *   table.  Chunk 0 goes into fs itself, continuing any partial word it
+ *   holds.  The other tables are merged into fs at the end, and the word
+ *   cut off by the end of data, if any, is moved to fs->partial for the
+ *   next call.
+ *   Returns SF_OK or SF_ERR_MEM.
+ */
+int freq_parallel(freq_state_t *fs, const char *data, size_t len, int jobs) {
+    freq_job_t job[SF_MAX_JOBS];
+    freq_state_t local[SF_MAX_JOBS];
+    pthread_t tid[SF_MAX_JOBS];
+    bool started[SF_MAX_JOBS] = {false};
+    int rc = SF_OK;
+    int n = 0;
+
+    if (jobs > SF_MAX_JOBS) {
+        jobs = SF_MAX_JOBS;
+    }
+    if ((size_t)jobs > len / SF_PAR_MIN_CHUNK) {
+        jobs = len / SF_PAR_MIN_CHUNK;
+    }
+    if (jobs <= 1) {
+        return freq_feed(fs, data, len);
+    }
+
+    size_t per = len / jobs;
+    size_t start = 0;
+    while (start < len && n < jobs) {
+        size_t end = (n == jobs - 1) ? len : (n + 1) * per;
+        if (end < start) {
+            end = start;
+        }
+        while (end < len && !IS_WORD_SEP(data[end])) {
+            end++; // Do not cut a word
+        }
+        if (end < len) {
+            end++;
+        }
+        job[n].data = data + start;
+        job[n].len = end - start;
+        job[n].fs = fs;
+        if (n > 0) {
+            if (freq_begin(&local[n]) != SF_OK) {
+                job[n].len = len - start; // Out of memory, the rest goes to fs
+                n++;
+                break;
+            }
+            job[n].fs = &local[n];
+        }
+        start = end;
+        n++;
+    }
+
+    for (int i = 1; i < n; i++) {
+        if (job[i].fs != fs) {
+            started[i] = pthread_create(&tid[i], NULL, freq_job_run, &job[i]) == 0;
+        }
+    }
+    freq_job_run(&job[0]);
+    for (int i = 1; i < n; i++) {
+        if (started[i]) {
+            pthread_join(tid[i], NULL);
+        } else {
+            freq_job_run(&job[i]);
+        }
+    }
+
+    // Merge in order, the last chunk's partial word carries to the next call
+    for (int i = 0; i < n; i++) {
+        if (job[i].rc != SF_OK) {
+            rc = job[i].rc;
+        }
+        if (job[i].fs == fs) {
+            continue;
+        }
+        if (rc == SF_OK && freq_merge(&fs->tab, &job[i].fs->tab) != SF_OK) {
+            rc = SF_ERR_MEM;
+        }
+        if (rc == SF_OK && i == n - 1 && job[i].fs->partial.len > 0) {
+            fs->partial.len = 0;
+            if (sb_append(&fs->partial, job[i].fs->partial.data, job[i].fs->partial.len) != SB_OK) {
+                rc = SF_ERR_MEM;
+            }
+        }
+        freq_free(job[i].fs);
+    }
+    return rc;
+}
@@ -0,0 +1,40 @@
+#ifndef __SFPAR_H__
+#define __SFPAR_H__
+
+#include <stddef.h>
+
+#include "sffreq.h"
+#include "sflib.h"
+#include "sfsimd.h"
+
+// Upper limit for -j, and the smallest piece of input worth a thread
+#define SF_MAX_JOBS         64
+#define SF_PAR_MIN_CHUNK    (1024 * 1024)
+
+// Batch size per job when the input is a pipe and has to be read into
+// memory before it can be split
+#define SF_PAR_BATCH_SZ     (4 * 1024 * 1024)
+
+// Work for one thread.  Chunks are counted independently, each starting
+// outside a word, and wc_parallel() stitches them back together.
+typedef struct wc_job {
+    wc_kernel_fn count;
+    const char  *data;
+    size_t       len;
+    long         words;
+    bool         in_word;   // state at the end of the chunk
+} wc_job_t;
+
+void wc_parallel(wc_state_t *st, const char *data, size_t len, int jobs);
+
+// Work for one -F thread, chunks are cut at word boundaries
+typedef struct freq_job {
+    freq_state_t *fs;
+    const char   *data;
+    size_t        len;
+    int           rc;
+} freq_job_t;
+
+int freq_parallel(freq_state_t *fs, const char *data, size_t len, int jobs);
+
+#endif
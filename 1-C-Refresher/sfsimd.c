@@ -0,0 +1,669 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sflib.h"
+#include "sfsimd.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SF_X86 1
+#endif
+
+// Reference kernel, one branch per byte
+long wc_count_scalar(const char *data, size_t len, bool *in_word) {
+    bool iw = *in_word;
+    long words = 0;
+
+    for (size_t i = 0; i < len; i++) {
+        if (IS_WORD_SEP(data[i])) {
+            iw = false; // A separator ends the current word
+        } else if (!iw) {
+            words++;
+            iw = true; // First character of a new word
+        }
+    }
+    *in_word = iw;
+    return words;
+}
+
+// Reference reversal, swaps one byte from each end at a time
+void rev_bytes_scalar(char *data, size_t len) {
+    char *start = data;
+    char *end = data + len - 1;
+
+    if (len < 2) {
+        return;
+    }
+    while (start < end) {
+        char temp = *start;
+        *start = *end;
+        *end = temp;
+        start++;
+        end--;
+    }
+}
+
+// Reference space squeezing, one branch per byte
+size_t squeeze_scalar(char *dst, const char *src, size_t len, bool *at_space) {
+    bool sp = *at_space;
+    char *d = dst;
+
+    for (size_t i = 0; i < len; i++) {
+        if (src[i] != SPACE_CHAR) {
+            *d++ = src[i]; // Copy non-space character
+            sp = false;
+        } else if (!sp) {
+            *d++ = SPACE_CHAR; // Only copy a single space
+            sp = true;
+        }
+    }
+    *at_space = sp;
+    return d - dst;
+}
+
+// Reference UTF-8 validation, RFC 3629: no overlong forms, no surrogates,
+// nothing above U+10FFFF
+int utf8_check_scalar(const char *data, size_t len) {
+    const unsigned char *p = (const unsigned char *)data;
+    const unsigned char *end = p + len;
+    bool ascii = true;
+
+    while (p < end) {
+        unsigned char c = *p;
+        if (c < 0x80) {
+            p++;
+            continue;
+        }
+        ascii = false;
+
+        size_t n;
+        unsigned char lo = 0x80, hi = 0xbf; // Allowed range of the second byte
+        if (c >= 0xc2 && c <= 0xdf) {
+            n = 2;
+        } else if (c >= 0xe0 && c <= 0xef) {
+            n = 3;
+            lo = (c == 0xe0) ? 0xa0 : 0x80; // Overlong
+            hi = (c == 0xed) ? 0x9f : 0xbf; // Surrogates
+        } else if (c >= 0xf0 && c <= 0xf4) {
+            n = 4;
+            lo = (c == 0xf0) ? 0x90 : 0x80; // Overlong
+            hi = (c == 0xf4) ? 0x8f : 0xbf; // Above U+10FFFF
+        } else {
+            return UTF8_INVALID;
+        }
+
+        if ((size_t)(end - p) < n || p[1] < lo || p[1] > hi) {
+            return UTF8_INVALID;
+        }
+        for (size_t i = 2; i < n; i++) {
+            if ((p[i] & 0xc0) != 0x80) {
+                return UTF8_INVALID;
+            }
+        }
+        p += n;
+    }
+    return ascii ? UTF8_ASCII : UTF8_VALID;
+}
+
+static bool always_supported(void) {
+    return true;
+}
+
+#ifdef SF_X86
+
+// The vector kernels build a 64 bit mask with one bit per byte that is set
+// for separators.  A word starts at every non-separator byte whose previous
+// byte is a separator, so the starts in a block are
+//
+//     ~sep & ((sep << 1) | prev_sep)
+//
+// where prev_sep is the separator bit of the last byte of the block before.
+// popcount of that mask is the number of words starting in the block.
+
+// Separator test for 16 bytes: ' ', or '\t' <= c <= '\r' done as an
+// unsigned range check with min_epu8
+static inline uint32_t sep_mask_sse2(const char *p) {
+    const __m128i space = _mm_set1_epi8(SPACE_CHAR);
+    const __m128i tab = _mm_set1_epi8('\t');
+    const __m128i span = _mm_set1_epi8('\r' - '\t');
+    __m128i v = _mm_loadu_si128((const __m128i *)p);
+    __m128i t = _mm_sub_epi8(v, tab);
+    __m128i ws = _mm_or_si128(_mm_cmpeq_epi8(v, space),
+                              _mm_cmpeq_epi8(_mm_min_epu8(t, span), t));
+    return (uint32_t)_mm_movemask_epi8(ws);
+}
+
+static long wc_count_sse2(const char *data, size_t len, bool *in_word) {
+    uint64_t prev_sep = *in_word ? 0 : 1;
+    long words = 0;
+    size_t i = 0;
+
+    for (; i + 64 <= len; i += 64) {
+        uint64_t sep = (uint64_t)sep_mask_sse2(data + i)
+                     | (uint64_t)sep_mask_sse2(data + i + 16) << 16
+                     | (uint64_t)sep_mask_sse2(data + i + 32) << 32
+                     | (uint64_t)sep_mask_sse2(data + i + 48) << 48;
+        words += __builtin_popcountll(~sep & ((sep << 1) | prev_sep));
+        prev_sep = sep >> 63;
+    }
+
+    bool iw = !prev_sep;
+    words += wc_count_scalar(data + i, len - i, &iw);
+    *in_word = iw;
+    return words;
+}
+
+__attribute__((target("avx2")))
+static inline uint32_t sep_mask_avx2(const char *p) {
+    const __m256i space = _mm256_set1_epi8(SPACE_CHAR);
+    const __m256i tab = _mm256_set1_epi8('\t');
+    const __m256i span = _mm256_set1_epi8('\r' - '\t');
+    __m256i v = _mm256_loadu_si256((const __m256i *)p);
+    __m256i t = _mm256_sub_epi8(v, tab);
+    __m256i ws = _mm256_or_si256(_mm256_cmpeq_epi8(v, space),
+                                 _mm256_cmpeq_epi8(_mm256_min_epu8(t, span), t));
+    return (uint32_t)_mm256_movemask_epi8(ws);
+}
+
+__attribute__((target("avx2,popcnt")))
+static long wc_count_avx2(const char *data, size_t len, bool *in_word) {
+    uint64_t prev_sep = *in_word ? 0 : 1;
+    long words = 0;
+    size_t i = 0;
+
+    for (; i + 64 <= len; i += 64) {
+        uint64_t sep = (uint64_t)sep_mask_avx2(data + i)
+                     | (uint64_t)sep_mask_avx2(data + i + 32) << 32;
+        words += __builtin_popcountll(~sep & ((sep << 1) | prev_sep));
+        prev_sep = sep >> 63;
+    }
+
+    bool iw = !prev_sep;
+    words += wc_count_scalar(data + i, len - i, &iw);
+    *in_word = iw;
+    return words;
+}
+
+// The vector reversals load one block from each end, reverse the bytes of
+// both with a shuffle and store each at the opposite end, so every byte is
+// read and written once.  Whatever is left in the middle is less than two
+// blocks and goes to the scalar version.
+
+__attribute__((target("ssse3")))
+static void rev_bytes_ssse3(char *data, size_t len) {
+    const __m128i rev = _mm_setr_epi8(15, 14, 13, 12, 11, 10, 9, 8,
+                                      7, 6, 5, 4, 3, 2, 1, 0);
+    char *lo = data;
+    char *hi = data + len;
+
+    while (hi - lo >= 32) {
+        hi -= 16;
+        __m128i a = _mm_loadu_si128((const __m128i *)lo);
+        __m128i b = _mm_loadu_si128((const __m128i *)hi);
+        _mm_storeu_si128((__m128i *)lo, _mm_shuffle_epi8(b, rev));
+        _mm_storeu_si128((__m128i *)hi, _mm_shuffle_epi8(a, rev));
+        lo += 16;
+    }
+    rev_bytes_scalar(lo, hi - lo);
+}
+
+// pshufb only works within 128 bit lanes, so the two lanes are swapped
+// afterwards with vpermq
+__attribute__((target("avx2")))
+static inline __m256i rev32_avx2(__m256i v) {
+    const __m256i rev = _mm256_setr_epi8(15, 14, 13, 12, 11, 10, 9, 8,
+                                         7, 6, 5, 4, 3, 2, 1, 0,
+                                         15, 14, 13, 12, 11, 10, 9, 8,
+                                         7, 6, 5, 4, 3, 2, 1, 0);
+    return _mm256_permute4x64_epi64(_mm256_shuffle_epi8(v, rev), 0x4e);
+}
+
+__attribute__((target("avx2")))
+static void rev_bytes_avx2(char *data, size_t len) {
+    char *lo = data;
+    char *hi = data + len;
+
+    while (hi - lo >= 64) {
+        hi -= 32;
+        __m256i a = _mm256_loadu_si256((const __m256i *)lo);
+        __m256i b = _mm256_loadu_si256((const __m256i *)hi);
+        _mm256_storeu_si256((__m256i *)lo, rev32_avx2(b));
+        _mm256_storeu_si256((__m256i *)hi, rev32_avx2(a));
+        lo += 32;
+    }
+    rev_bytes_ssse3(lo, hi - lo);
+}
+
+// Vector UTF-8 validation with the lookup algorithm of Keiser and Lemire
+// ("Validating UTF-8 in less than one instruction per byte").  Three table
+// lookups on the high nibble of the previous byte, its low nibble and the
+// high nibble of the current byte give a bit mask of the errors each byte
+// pair could be part of; and-ing them leaves the errors that really
+// happened.  The third and fourth bytes of long sequences are checked with
+// two saturating subtractions on the bytes two and three back.  A block
+// that ends inside a sequence must be followed by its continuation, which
+// is checked against the next block or at the end.
+
+#define U8_TOO_SHORT        (1 << 0)
+#define U8_TOO_LONG         (1 << 1)
+#define U8_OVERLONG_3       (1 << 2)
+#define U8_TOO_LARGE        (1 << 3)
+#define U8_SURROGATE        (1 << 4)
+#define U8_OVERLONG_2       (1 << 5)
+#define U8_TOO_LARGE_1000   (1 << 6)
+#define U8_OVERLONG_4       (1 << 6)
+#define U8_TWO_CONTS        (1 << 7)
+#define U8_CARRY            (U8_TOO_SHORT | U8_TOO_LONG | U8_TWO_CONTS)
+
+#define U8_BYTE_1_HIGH \
+    U8_TOO_LONG, U8_TOO_LONG, U8_TOO_LONG, U8_TOO_LONG, \
+    U8_TOO_LONG, U8_TOO_LONG, U8_TOO_LONG, U8_TOO_LONG, \
+    U8_TWO_CONTS, U8_TWO_CONTS, U8_TWO_CONTS, U8_TWO_CONTS, \
+    U8_TOO_SHORT | U8_OVERLONG_2, \
+    U8_TOO_SHORT, \
+    U8_TOO_SHORT | U8_OVERLONG_3 | U8_SURROGATE, \
+    U8_TOO_SHORT | U8_TOO_LARGE | U8_TOO_LARGE_1000 | U8_OVERLONG_4
+
+#define U8_BYTE_1_LOW \
+    U8_CARRY | U8_OVERLONG_3 | U8_OVERLONG_2 | U8_OVERLONG_4, \
+    U8_CARRY | U8_OVERLONG_2, \
+    U8_CARRY, \
+    U8_CARRY, \
+    U8_CARRY | U8_TOO_LARGE, \
+    U8_CARRY | U8_TOO_LARGE | U8_TOO_LARGE_1000, \
+    U8_CARRY | U8_TOO_LARGE | U8_TOO_LARGE_1000, \
+    U8_CARRY | U8_TOO_LARGE | U8_TOO_LARGE_1000, \
+    U8_CARRY | U8_TOO_LARGE | U8_TOO_LARGE_1000, \
+    U8_CARRY | U8_TOO_LARGE | U8_TOO_LARGE_1000, \
+    U8_CARRY | U8_TOO_LARGE | U8_TOO_LARGE_1000, \
+    U8_CARRY | U8_TOO_LARGE | U8_TOO_LARGE_1000, \
+    U8_CARRY | U8_TOO_LARGE | U8_TOO_LARGE_1000, \
+    U8_CARRY | U8_TOO_LARGE | U8_TOO_LARGE_1000 | U8_SURROGATE, \
+    U8_CARRY | U8_TOO_LARGE | U8_TOO_LARGE_1000, \
+    U8_CARRY | U8_TOO_LARGE | U8_TOO_LARGE_1000
+
+#define U8_BYTE_2_HIGH \
+    U8_TOO_SHORT, U8_TOO_SHORT, U8_TOO_SHORT, U8_TOO_SHORT, \
+    U8_TOO_SHORT, U8_TOO_SHORT, U8_TOO_SHORT, U8_TOO_SHORT, \
+    U8_TOO_LONG | U8_OVERLONG_2 | U8_TWO_CONTS | U8_OVERLONG_3 | U8_TOO_LARGE_1000 | U8_OVERLONG_4, \
+    U8_TOO_LONG | U8_OVERLONG_2 | U8_TWO_CONTS | U8_OVERLONG_3 | U8_TOO_LARGE, \
+    U8_TOO_LONG | U8_OVERLONG_2 | U8_TWO_CONTS | U8_SURROGATE | U8_TOO_LARGE, \
+    U8_TOO_LONG | U8_OVERLONG_2 | U8_TWO_CONTS | U8_SURROGATE | U8_TOO_LARGE, \
+    U8_TOO_SHORT, U8_TOO_SHORT, U8_TOO_SHORT, U8_TOO_SHORT
+
+// The last three bytes of a block may start a sequence only if it fits
+#define U8_INCOMPLETE_MAX   0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, \
+                            0xff, 0xff, 0xff, 0xff, 0xff, 0xef, 0xdf, 0xbf
+
+__attribute__((target("ssse3")))
+static inline __m128i utf8_errors_ssse3(__m128i in, __m128i prev) {
+    const __m128i byte_1_high = _mm_setr_epi8(U8_BYTE_1_HIGH);
+    const __m128i byte_1_low = _mm_setr_epi8(U8_BYTE_1_LOW);
+    const __m128i byte_2_high = _mm_setr_epi8(U8_BYTE_2_HIGH);
+    const __m128i nibble = _mm_set1_epi8(0x0f);
+
+    __m128i prev1 = _mm_alignr_epi8(in, prev, 15);
+    __m128i sc = _mm_and_si128(
+        _mm_and_si128(
+            _mm_shuffle_epi8(byte_1_high, _mm_and_si128(_mm_srli_epi16(prev1, 4), nibble)),
+            _mm_shuffle_epi8(byte_1_low, _mm_and_si128(prev1, nibble))),
+        _mm_shuffle_epi8(byte_2_high, _mm_and_si128(_mm_srli_epi16(in, 4), nibble)));
+
+    __m128i prev2 = _mm_alignr_epi8(in, prev, 14);
+    __m128i prev3 = _mm_alignr_epi8(in, prev, 13);
+    __m128i third = _mm_subs_epu8(prev2, _mm_set1_epi8(0xe0 - 0x80));
+    __m128i fourth = _mm_subs_epu8(prev3, _mm_set1_epi8(0xf0 - 0x80));
+    __m128i must23 = _mm_and_si128(_mm_or_si128(third, fourth), _mm_set1_epi8((char)0x80));
+    return _mm_xor_si128(must23, sc);
+}
+
+__attribute__((target("ssse3")))
+static int utf8_check_ssse3(const char *data, size_t len) {
+    const __m128i incomplete_max = _mm_setr_epi8(U8_INCOMPLETE_MAX);
+    __m128i prev = _mm_setzero_si128();
+    __m128i error = _mm_setzero_si128();
+    __m128i incomplete = _mm_setzero_si128();
+    __m128i high = _mm_setzero_si128();
+    char tail[16] = {0};
+    size_t i = 0;
+
+    while (i < len) {
+        __m128i in;
+        if (len - i >= 16) {
+            in = _mm_loadu_si128((const __m128i *)(data + i));
+        } else {
+            memcpy(tail, data + i, len - i); // Zero padding is plain ASCII
+            in = _mm_loadu_si128((const __m128i *)tail);
+        }
+        i += 16;
+
+        high = _mm_or_si128(high, in);
+        if (_mm_movemask_epi8(in) == 0) {
+            error = _mm_or_si128(error, incomplete); // An ASCII block after an open sequence
+            incomplete = _mm_setzero_si128();
+        } else {
+            error = _mm_or_si128(error, utf8_errors_ssse3(in, prev));
+            incomplete = _mm_subs_epu8(in, incomplete_max);
+        }
+        prev = in;
+    }
+    error = _mm_or_si128(error, incomplete);
+
+    if (_mm_movemask_epi8(_mm_cmpeq_epi8(error, _mm_setzero_si128())) != 0xffff) {
+        return UTF8_INVALID;
+    }
+    return _mm_movemask_epi8(high) ? UTF8_VALID : UTF8_ASCII;
+}
+
+// AVX2 version of the above.  The byte shifts across the previous block
+// need the upper lane of prev next to the lower lane of in, made with
+// vperm2i128, because valignr only works within lanes.
+__attribute__((target("avx2")))
+static inline __m256i utf8_errors_avx2(__m256i in, __m256i prev) {
+    const __m256i byte_1_high = _mm256_setr_epi8(U8_BYTE_1_HIGH, U8_BYTE_1_HIGH);
+    const __m256i byte_1_low = _mm256_setr_epi8(U8_BYTE_1_LOW, U8_BYTE_1_LOW);
+    const __m256i byte_2_high = _mm256_setr_epi8(U8_BYTE_2_HIGH, U8_BYTE_2_HIGH);
+    const __m256i nibble = _mm256_set1_epi8(0x0f);
+
+    __m256i cross = _mm256_permute2x128_si256(prev, in, 0x21);
+    __m256i prev1 = _mm256_alignr_epi8(in, cross, 15);
+    __m256i sc = _mm256_and_si256(
+        _mm256_and_si256(
+            _mm256_shuffle_epi8(byte_1_high, _mm256_and_si256(_mm256_srli_epi16(prev1, 4), nibble)),
+            _mm256_shuffle_epi8(byte_1_low, _mm256_and_si256(prev1, nibble))),
+        _mm256_shuffle_epi8(byte_2_high, _mm256_and_si256(_mm256_srli_epi16(in, 4), nibble)));
+
+    __m256i prev2 = _mm256_alignr_epi8(in, cross, 14);
+    __m256i prev3 = _mm256_alignr_epi8(in, cross, 13);
+    __m256i third = _mm256_subs_epu8(prev2, _mm256_set1_epi8(0xe0 - 0x80));
+    __m256i fourth = _mm256_subs_epu8(prev3, _mm256_set1_epi8(0xf0 - 0x80));
+    __m256i must23 = _mm256_and_si256(_mm256_or_si256(third, fourth), _mm256_set1_epi8((char)0x80));
+    return _mm256_xor_si256(must23, sc);
+}
+
+__attribute__((target("avx2")))
+static int utf8_check_avx2(const char *data, size_t len) {
+    const __m256i incomplete_max = _mm256_setr_epi8(
+        0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+        0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, U8_INCOMPLETE_MAX);
+    __m256i prev = _mm256_setzero_si256();
+    __m256i error = _mm256_setzero_si256();
+    __m256i incomplete = _mm256_setzero_si256();
+    __m256i high = _mm256_setzero_si256();
+    char tail[32] = {0};
+    size_t i = 0;
+
+    while (i < len) {
+        __m256i in;
+        if (len - i >= 32) {
+            in = _mm256_loadu_si256((const __m256i *)(data + i));
+        } else {
+            memcpy(tail, data + i, len - i);
+            in = _mm256_loadu_si256((const __m256i *)tail);
+        }
+        i += 32;
+
+        high = _mm256_or_si256(high, in);
+        if (_mm256_movemask_epi8(in) == 0) {
+            error = _mm256_or_si256(error, incomplete);
+            incomplete = _mm256_setzero_si256();
+        } else {
+            error = _mm256_or_si256(error, utf8_errors_avx2(in, prev));
+            incomplete = _mm256_subs_epu8(in, incomplete_max);
+        }
+        prev = in;
+    }
+    error = _mm256_or_si256(error, incomplete);
+
+    if (!_mm256_testz_si256(error, error)) {
+        return UTF8_INVALID;
+    }
+    return _mm256_movemask_epi8(high) ? UTF8_VALID : UTF8_ASCII;
+}
+
+// The squeeze kernels mark the spaces of a block in a bit mask the same
+// way and keep every byte except a space whose previous byte is a space:
+//
+//     keep = ~(sp & ((sp << 1) | prev_sp))
+//
+// The kept bytes are packed to the front 8 at a time with pshufb, the
+// shuffle for each 8 bit keep mask coming from a 256 entry table, and
+// stored as a whole 8 byte word; dst then advances by the number kept.
+// Blocks without two spaces in a row are copied as they are.
+// AVX-512 VBMI2 has an instruction for the packing, vpcompressb.
+
+static uint8_t sqz_shuf[256][8];    // source byte for each kept byte
+static uint8_t sqz_len[256];        // number of bytes kept
+
+static void sqz_table_init(void) {
+    static bool done = false;
+
+    if (done) {
+        return;
+    }
+    for (int m = 0; m < 256; m++) {
+        int n = 0;
+        for (int b = 0; b < 8; b++) {
+            if (m & (1 << b)) {
+                sqz_shuf[m][n++] = b;
+            }
+        }
+        sqz_len[m] = n;
+        while (n < 8) {
+            sqz_shuf[m][n++] = 0x80; // pshufb writes a zero
+        }
+    }
+    done = true;
+}
+
+// Pack the kept bytes of the 8 bytes at src to d, returns the new end
+__attribute__((target("ssse3")))
+static inline char *sqz_pack8(char *d, const char *src, uint32_t keep) {
+    __m128i v = _mm_loadl_epi64((const __m128i *)src);
+    __m128i shuf = _mm_loadl_epi64((const __m128i *)sqz_shuf[keep]);
+    _mm_storel_epi64((__m128i *)d, _mm_shuffle_epi8(v, shuf));
+    return d + sqz_len[keep];
+}
+
+__attribute__((target("ssse3")))
+static size_t squeeze_ssse3(char *dst, const char *src, size_t len, bool *at_space) {
+    const __m128i space = _mm_set1_epi8(SPACE_CHAR);
+    uint32_t prev = *at_space;
+    char *d = dst;
+    size_t i = 0;
+
+    sqz_table_init();
+    for (; i + 16 <= len; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(src + i));
+        uint32_t sp = _mm_movemask_epi8(_mm_cmpeq_epi8(v, space));
+        uint32_t keep = ~(sp & ((sp << 1) | prev)) & 0xffff;
+        prev = sp >> 15;
+        if (keep == 0xffff) {
+            _mm_storeu_si128((__m128i *)d, v);
+            d += 16;
+            continue;
+        }
+        d = sqz_pack8(d, src + i, keep & 0xff);
+        d = sqz_pack8(d, src + i + 8, keep >> 8);
+    }
+    bool sp = prev;
+    d += squeeze_scalar(d, src + i, len - i, &sp);
+    *at_space = sp;
+    return d - dst;
+}
+
+__attribute__((target("avx2")))
+static size_t squeeze_avx2(char *dst, const char *src, size_t len, bool *at_space) {
+    const __m256i space = _mm256_set1_epi8(SPACE_CHAR);
+    uint32_t prev = *at_space;
+    char *d = dst;
+    size_t i = 0;
+
+    sqz_table_init();
+    for (; i + 32 <= len; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(src + i));
+        uint32_t sp = _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, space));
+        uint32_t keep = ~(sp & ((sp << 1) | prev));
+        prev = sp >> 31;
+        if (keep == 0xffffffff) {
+            _mm256_storeu_si256((__m256i *)d, v);
+            d += 32;
+            continue;
+        }
+        for (int g = 0; g < 32; g += 8) {
+            d = sqz_pack8(d, src + i + g, (keep >> g) & 0xff);
+        }
+    }
+    bool sp = prev;
+    d += squeeze_scalar(d, src + i, len - i, &sp);
+    *at_space = sp;
+    return d - dst;
+}
+
+// vpcompressb packs all 64 bytes at once.  The packed block is written
+// whole rather than with the masked compress store, which is slow on some
+// CPUs.
+__attribute__((target("avx512f,avx512bw,avx512vbmi2,popcnt")))
+static size_t squeeze_vbmi2(char *dst, const char *src, size_t len, bool *at_space) {
+    const __m512i space = _mm512_set1_epi8(SPACE_CHAR);
+    uint64_t prev = *at_space;
+    char *d = dst;
+    size_t i = 0;
+
+    for (; i + 64 <= len; i += 64) {
+        __m512i v = _mm512_loadu_si512((const void *)(src + i));
+        uint64_t sp = _mm512_cmpeq_epi8_mask(v, space);
+        uint64_t keep = ~(sp & ((sp << 1) | prev));
+        prev = sp >> 63;
+        _mm512_storeu_si512((void *)d, _mm512_maskz_compress_epi8(keep, v));
+        d += __builtin_popcountll(keep);
+    }
+    bool sp = prev;
+    d += squeeze_scalar(d, src + i, len - i, &sp);
+    *at_space = sp;
+    return d - dst;
+}
+
+static bool ssse3_supported(void) {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("ssse3");
+}
+
+static bool avx2_supported(void) {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt");
+}
+
+static bool vbmi2_supported(void) {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx512bw") && __builtin_cpu_supports("avx512vbmi2") &&
+           __builtin_cpu_supports("popcnt");
+}
+
+#endif
+
+const sf_kernel_t WC_KERNELS[] = {
+    { "scalar", wc_count_scalar, always_supported },
+#ifdef SF_X86
+    { "sse2",   wc_count_sse2,   always_supported },
+    { "avx2",   wc_count_avx2,   avx2_supported },
+#endif
+    { NULL, NULL, NULL },
+};
+
+const sf_rev_kernel_t REV_KERNELS[] = {
+    { "scalar", rev_bytes_scalar, always_supported },
+#ifdef SF_X86
+    { "ssse3",  rev_bytes_ssse3,  ssse3_supported },
+    { "avx2",   rev_bytes_avx2,   avx2_supported },
+#endif
+    { NULL, NULL, NULL },
+};
+
+const sf_utf8_kernel_t UTF8_KERNELS[] = {
+    { "scalar", utf8_check_scalar, always_supported },
+#ifdef SF_X86
+    { "ssse3",  utf8_check_ssse3,  ssse3_supported },
+    { "avx2",   utf8_check_avx2,   avx2_supported },
+#endif
+    { NULL, NULL, NULL },
+};
+
+const sf_sqz_kernel_t SQZ_KERNELS[] = {
+    { "scalar", squeeze_scalar, always_supported },
+#ifdef SF_X86
+    { "ssse3",  squeeze_ssse3,  ssse3_supported },
+    { "avx2",   squeeze_avx2,   avx2_supported },
+    { "vbmi2",  squeeze_vbmi2,  vbmi2_supported },
+#endif
+    { NULL, NULL, NULL },
+};
+
+// Should the kernel called name be used?  SF_KERNEL=<name> in the
+// environment forces one (for testing the others against the reference),
+// otherwise the last supported one in the table wins
+static bool kernel_wanted(const char *name, bool (*supported)(void)) {
+    const char *force = getenv("SF_KERNEL");
+    return supported() && (force == NULL || strcmp(force, name) == 0);
+}
+
+// Pick the fastest word counting kernel the CPU supports
+wc_kernel_fn wc_kernel(void) {
+    static wc_kernel_fn chosen = NULL;
+
+    if (chosen == NULL) {
+        chosen = wc_count_scalar;
+        for (const sf_kernel_t *k = WC_KERNELS; k->name; k++) {
+            if (kernel_wanted(k->name, k->supported)) {
+                chosen = k->fn;
+            }
+        }
+    }
+    return chosen;
+}
+
+// Pick the fastest reversal kernel the CPU supports
+rev_kernel_fn rev_kernel(void) {
+    static rev_kernel_fn chosen = NULL;
+
+    if (chosen == NULL) {
+        chosen = rev_bytes_scalar;
+        for (const sf_rev_kernel_t *k = REV_KERNELS; k->name; k++) {
+            if (kernel_wanted(k->name, k->supported)) {
+                chosen = k->fn;
+            }
+        }
+    }
+    return chosen;
+}
+
+// Pick the fastest UTF-8 validator the CPU supports
+utf8_kernel_fn utf8_kernel(void) {
+    static utf8_kernel_fn chosen = NULL;
+
+    if (chosen == NULL) {
+        chosen = utf8_check_scalar;
+        for (const sf_utf8_kernel_t *k = UTF8_KERNELS; k->name; k++) {
+            if (kernel_wanted(k->name, k->supported)) {
+                chosen = k->fn;
+            }
+        }
+    }
+    return chosen;
+}
+
+// Pick the fastest space squeezing kernel the CPU supports
+sqz_kernel_fn sqz_kernel(void) {
+    static sqz_kernel_fn chosen = NULL;
+
+    if (chosen == NULL) {
+        chosen = squeeze_scalar;
+        for (const sf_sqz_kernel_t *k = SQZ_KERNELS; k->name; k++) {
+            if (kernel_wanted(k->name, k->supported)) {
+                chosen = k->fn;
+            }
+        }
+    }
+    return chosen;
+}
@@ -0,0 +1,77 @@
+#ifndef __SFSIMD_H__
+#define __SFSIMD_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Word counting kernels.  Each one counts the words that start in
+// data[0..len) and updates *in_word, which says whether the byte before the
+// chunk was part of a word, so chunks can be counted one after another.
+// All kernels must return exactly what wc_count_scalar() returns.
+typedef long (*wc_kernel_fn)(const char *data, size_t len, bool *in_word);
+
+typedef struct sf_kernel {
+    const char   *name;
+    wc_kernel_fn  fn;
+    bool        (*supported)(void);
+} sf_kernel_t;
+
+long wc_count_scalar(const char *data, size_t len, bool *in_word);
+
+// Kernels in order from the reference to the fastest, the table ends with
+// a NULL name.  wc_kernel() picks the last supported one on first use.
+extern const sf_kernel_t WC_KERNELS[];
+wc_kernel_fn wc_kernel(void);
+
+// Byte reversal kernels, reverse data[0..len) in place
+typedef void (*rev_kernel_fn)(char *data, size_t len);
+
+typedef struct sf_rev_kernel {
+    const char    *name;
+    rev_kernel_fn  fn;
+    bool         (*supported)(void);
+} sf_rev_kernel_t;
+
+void rev_bytes_scalar(char *data, size_t len);
+
+extern const sf_rev_kernel_t REV_KERNELS[];
+rev_kernel_fn rev_kernel(void);
+
+// UTF-8 validation kernels, return one of the UTF8_* results below
+#define UTF8_INVALID    -1
+#define UTF8_VALID       0  // valid, with multibyte characters
+#define UTF8_ASCII       1  // valid, every byte below 0x80
+
+typedef int (*utf8_kernel_fn)(const char *data, size_t len);
+
+typedef struct sf_utf8_kernel {
+    const char     *name;
+    utf8_kernel_fn  fn;
+    bool          (*supported)(void);
+} sf_utf8_kernel_t;
+
+int utf8_check_scalar(const char *data, size_t len);
+
+extern const sf_utf8_kernel_t UTF8_KERNELS[];
+utf8_kernel_fn utf8_kernel(void);
+
+// Space squeezing kernels for setup_buff().  Copy src[0..len) to dst
+// dropping every ' ' that follows another ' ', and returns the number of
+// bytes written.  *at_space says whether the byte before src was a space
+// (true at the start of the string, so leading spaces go too) and is
+// updated for the next call.  dst must have room for len bytes, the vector
+// kernels write whole blocks there.
+typedef size_t (*sqz_kernel_fn)(char *dst, const char *src, size_t len, bool *at_space);
+
+typedef struct sf_sqz_kernel {
+    const char    *name;
+    sqz_kernel_fn  fn;
+    bool         (*supported)(void);
+} sf_sqz_kernel_t;
+
+size_t squeeze_scalar(char *dst, const char *src, size_t len, bool *at_space);
+
+extern const sf_sqz_kernel_t SQZ_KERNELS[];
+sqz_kernel_fn sqz_kernel(void);
+
+#endif
@@ -0,0 +1,592 @@
+#define _GNU_SOURCE // memmem()
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "sffreq.h"
+#include "sflib.h"
+#include "sfout.h"
+#include "sfpar.h"
+#include "sfsimd.h"
+#include "sfstream.h"
+#include "sfutf8.h"
+
+// Open the input, path NULL or "-" means stdin.  Regular files are mapped,
+// everything else falls back to chunked reads.
+int sf_input_open(sf_input_t *in, const char *path) {
+    struct stat st;
+
+    memset(in, 0, sizeof(*in));
+    if (path == NULL || strcmp(path, SF_STDIN_ARG) == 0) {
+        in->fd = STDIN_FILENO;
+    } else {
+        in->fd = open(path, O_RDONLY);
+        if (in->fd < 0) {
+            return -1;
+        }
+    }
+
+    if (fstat(in->fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+        void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, in->fd, 0);
+        if (map != MAP_FAILED) {
+            madvise(map, st.st_size, MADV_SEQUENTIAL); // Read ahead aggressively
+            in->mapped = true;
+            in->map = map;
+            in->map_len = st.st_size;
+            return 0;
+        }
+    }
+
+    in->buf = malloc(SF_CHUNK_SZ);
+    if (in->buf == NULL) {
+        sf_input_close(in);
+        return -1;
+    }
+    return 0;
+}
+
+// Get the next chunk of input.  Returns its length, 0 at end of input or -1
+// on a read error.  The chunk stays valid until the next call.
+ssize_t sf_input_next(sf_input_t *in, const char **chunk) {
+    if (in->mapped) {
+        if (in->map_done) {
+            return 0;
+        }
+        in->map_done = true;
+        *chunk = in->map;
+        return in->map_len;
+    }
+
+    while (1) {
+        ssize_t n = read(in->fd, in->buf, SF_CHUNK_SZ);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        *chunk = in->buf;
+        return n;
+    }
+}
+
+void sf_input_close(sf_input_t *in) {
+    if (in->mapped) {
+        munmap((void *)in->map, in->map_len);
+    }
+    free(in->buf);
+    if (in->fd > STDIN_FILENO) {
+        close(in->fd);
+    }
+    in->mapped = false;
+    in->buf = NULL;
+    in->fd = -1;
+}
+
+int replace_begin(replace_state_t *rs, const char *old_sub, const char *new_sub, bool all) {
+    rs->old_sub = old_sub;
+    rs->old_len = strlen(old_sub);
+    rs->new_sub = new_sub;
+    rs->new_len = strlen(new_sub);
+    rs->all = all;
+    rs->done = false;
+    rs->matches = 0;
+    return sb_init(&rs->carry, rs->old_len ? 2 * rs->old_len : SB_MIN_CAP);
+}
+
+// Write the text before a match and the replacement
+static void replace_emit(replace_state_t *rs, const char *pre, size_t pre_len) {
+    out_write(pre, pre_len);
+    out_write(rs->new_sub, rs->new_len);
+    rs->matches++;
+    rs->done = !rs->all;
+}
+
+// Replace old_sub in a stream of chunks, the first occurrence or all of them.
+// At most old_len - 1 bytes are held back between chunks, so a match that
+// straddles two (or more) chunks is still found.
+int replace_feed(replace_state_t *rs, const char *data, size_t len) {
+    strbuf_t *carry = &rs->carry;
+    size_t pos = 0;
+
+    if (rs->done || rs->old_len == 0) {
+        out_write(data, len);
+        return SF_OK;
+    }
+
+    size_t keep = rs->old_len - 1;
+
+    if (carry->len > 0) {
+        // A match starting in the carry ends in the first keep bytes of data
+        size_t before = carry->len;
+        size_t head = len < keep ? len : keep;
+        if (sb_append(carry, data, head) != SB_OK) {
+            return SF_ERR_MEM;
+        }
+        char *hit = memmem(carry->data, carry->len, rs->old_sub, rs->old_len);
+        if (hit && (size_t)(hit - carry->data) < before) {
+            size_t at = hit - carry->data;
+            replace_emit(rs, carry->data, at);
+            pos = at + rs->old_len - before; // Bytes of data in the match
+            carry->len = 0;
+        } else if (head < keep) {
+            // Small chunk, it all stays in the carry except what can no
+            // longer be the start of a match
+            if (carry->len > keep) {
+                size_t out = carry->len - keep;
+                out_write(carry->data, out);
+                memmove(carry->data, carry->data + out, keep);
+                carry->len = keep;
+            }
+            return SF_OK;
+        } else {
+            out_write(carry->data, before);
+            carry->len = 0;
+        }
+    }
+
+    // Matches inside this chunk
+    while (!rs->done) {
+        const char *hit = memmem(data + pos, len - pos, rs->old_sub, rs->old_len);
+        if (hit == NULL) {
+            break;
+        }
+        replace_emit(rs, data + pos, hit - (data + pos));
+        pos = hit - data + rs->old_len;
+    }
+    if (rs->done) {
+        out_write(data + pos, len - pos);
+        return SF_OK;
+    }
+
+    // Hold back the tail, it may be the start of a match
+    size_t hold = len - pos < keep ? len - pos : keep;
+    out_write(data + pos, len - pos - hold);
+    return sb_append(carry, data + len - hold, hold);
+}
+
+// Flush whatever is left in the carry
+void replace_end(replace_state_t *rs) {
+    out_write(rs->carry.data, rs->carry.len);
+    sb_free(&rs->carry);
+}
+
+// Reverse a whole input, bytes or (words set) word order.  A mapped file
+// is reversed back to front in blocks, other inputs, word order and UTF-8
+// have to be held in memory in full first.
+static int stream_reverse(sf_input_t *in, bool words, bool utf8) {
+    char block[64 * 1024];
+    rev_kernel_fn rev = rev_kernel();
+    strbuf_t all;
+    const char *data;
+    size_t len;
+
+    if (sb_init(&all, SB_MIN_CAP) != SB_OK) {
+        return SF_ERR_MEM;
+    }
+    if (in->mapped && !words && !utf8) {
+        data = in->map;
+        len = in->map_len;
+    } else {
+        const char *chunk;
+        ssize_t n;
+        while ((n = sf_input_next(in, &chunk)) > 0) {
+            if (sb_append(&all, chunk, n) != SB_OK) {
+                sb_free(&all);
+                return SF_ERR_MEM;
+            }
+        }
+        if (utf8) {
+            int check = utf8_kernel()(all.data, all.len);
+            if (check == UTF8_INVALID) {
+                sb_free(&all);
+                return SF_ERR_FORMAT;
+            }
+            utf8 = (check == UTF8_VALID); // ASCII takes the byte path
+        }
+        if (words || utf8) {
+            if (!utf8) {
+                reverse_words(all.data, all.len);
+            } else if (words) {
+                utf8_reverse_words(all.data, all.len);
+            } else {
+                utf8_reverse(all.data, all.len);
+            }
+            out_write(all.data, all.len);
+            sb_free(&all);
+            return SF_OK;
+        }
+        data = all.data;
+        len = all.len;
+    }
+
+    while (len > 0) {
+        size_t n = len < sizeof(block) ? len : sizeof(block);
+        memcpy(block, data + len - n, n);
+        rev(block, n);
+        out_write(block, n);
+        len -= n;
+    }
+    sb_free(&all);
+    return SF_OK;
+}
+
+// --utf8 callbacks, ASCII pieces go to the byte versions
+static int utf8_count_piece(void *ctx, const char *data, size_t len, bool ascii) {
+    wc_state_t *st = ctx;
+
+    if (ascii) {
+        wc_feed(st, data, len);
+    } else {
+        st->words += utf8_count_words(data, len, &st->in_word);
+    }
+    return SF_OK;
+}
+
+static int utf8_words_piece(void *ctx, const char *data, size_t len, bool ascii) {
+    if (ascii) {
+        words_feed(ctx, data, len);
+    } else {
+        utf8_words_feed(ctx, data, len);
+    }
+    return SF_OK;
+}
+
+// Feed the whole input through the UTF-8 validator to fn
+static int stream_utf8(sf_input_t *in, utf8_piece_fn fn, void *ctx, ssize_t *n) {
+    utf8_stream_t us = { .part_len = 0 };
+    const char *chunk;
+    int rc = SF_OK;
+
+    while (rc == SF_OK && (*n = sf_input_next(in, &chunk)) > 0) {
+        rc = utf8_stream_feed(&us, chunk, *n, fn, ctx);
+    }
+    if (rc == SF_OK) {
+        rc = utf8_stream_end(&us);
+    }
+    return rc;
+}
+
+// Parallel operations run over large pieces of the input
+typedef int (*par_fn)(void *state, const char *data, size_t len, int jobs);
+
+static int count_par(void *state, const char *data, size_t len, int jobs) {
+    wc_parallel(state, data, len, jobs);
+    return SF_OK;
+}
+
+static int freq_par(void *state, const char *data, size_t len, int jobs) {
+    return freq_parallel(state, data, len, jobs);
+}
+
+// Run a parallel operation over the input.  A mapped file is split up as a
+// whole, a pipe is read in batches big enough to give every thread a fair
+// share.  *n is set like the sf_input_next() loop leaves it: 0 at the end
+// of the input, -1 on a read error.
+static int stream_parallel(sf_input_t *in, par_fn fn, void *state, int jobs, ssize_t *n) {
+    const char *chunk;
+    strbuf_t batch;
+    int rc = SF_OK;
+
+    *n = 0;
+    if (in->mapped) {
+        while (rc == SF_OK && (*n = sf_input_next(in, &chunk)) > 0) {
+            rc = fn(state, chunk, *n, jobs);
+        }
+        return rc;
+    }
+
+    if (jobs > SF_MAX_JOBS) {
+        jobs = SF_MAX_JOBS; // More would only grow the batch
+    }
+    size_t batch_sz = (size_t)jobs * SF_PAR_BATCH_SZ;
+    if (sb_init(&batch, batch_sz) != SB_OK) {
+        return SF_ERR_MEM;
+    }
+    while (rc == SF_OK && (*n = sf_input_next(in, &chunk)) > 0) {
+        sb_append(&batch, chunk, *n); // Fits, the batch is flushed a chunk early
+        if (batch.len + SF_CHUNK_SZ > batch_sz) {
+            rc = fn(state, batch.data, batch.len, jobs);
+            batch.len = 0;
+        }
+    }
+    if (rc == SF_OK) {
+        rc = fn(state, batch.data, batch.len, jobs);
+    }
+    sb_free(&batch);
+    return rc;
+}
+
+/*
+ * batch_line
+ *   Runs the operation on one line of batch input.  The output is the same
+ *   as running stringfun with the line as the string argument, except that
+ *   a line without a match for -x prints its buffer unchanged and is counted
+ *   in missing, so every input line still gets its output.  buff is reused
+ *   for every line and only grows for a line longer than any before it.
+ */
+static int batch_line(const sf_args_t *args, strbuf_t *buff, const char *line, size_t len,
+                      long *missing) {
+    ssize_t str_len = setup_buff_n(buff, line, len, BUFFER_SZ);
+
+    if (str_len < 0) {
+        return SF_ERR_MEM;
+    }
+    switch (args->opt) {
+        case 'c':
+            out_str("Word Count: ");
+            out_long(count_words(buff->data, buff->len, str_len));
+            out_putc('\n');
+            break;
+        case 'r':
+            reverse_string(buff->data, str_len);
+            break;
+        case 'R':
+            reverse_words(buff->data, str_len);
+            break;
+        case 'w':
+            print_words_with_length(buff->data, buff->len, str_len); // Prints no buffer
+            return SF_OK;
+        case 'x':
+            str_len = replace_substring(buff, str_len, args->old_sub, args->new_sub, BUFFER_SZ);
+            if (str_len == SF_ERR_MEM) {
+                return SF_ERR_MEM;
+            }
+            if (str_len == SF_ERR_NOT_FOUND) {
+                (*missing)++;
+            }
+            break;
+    }
+    print_buff(buff);
+    return SF_OK;
+}
+
+/*
+ * run_batch
+ *   Batch mode, -b: every newline-terminated line of the input is one
+ *   string for the operation, so a pipeline pays for one exec instead of
+ *   one per line.  Lines are taken straight from the input chunks; only a
+ *   line cut by the end of a chunk is copied, into part.  Both buffers are
+ *   reused, so there is no allocation per line.
+ */
+int run_batch(const sf_args_t *args) {
+    sf_input_t in;
+    strbuf_t buff;
+    strbuf_t part;
+    const char *chunk;
+    ssize_t n = 0;
+    long missing = 0;
+    int rc = SF_OK;
+
+    if (sf_input_open(&in, args->path) != 0) {
+        fprintf(stderr, "Error: Cannot open input '%s': %s\n", args->path, strerror(errno));
+        return 2;
+    }
+    if (sb_init(&buff, BUFFER_SZ) != SB_OK || sb_init(&part, SB_MIN_CAP) != SB_OK) {
+        rc = SF_ERR_MEM;
+    }
+
+    while (rc == SF_OK && (n = sf_input_next(&in, &chunk)) > 0) {
+        const char *p = chunk;
+        const char *end = chunk + n;
+        const char *nl;
+
+        while (rc == SF_OK && (nl = memchr(p, '\n', end - p)) != NULL) {
+            if (part.len > 0) {
+                // Finish the line started in the previous chunk
+                rc = sb_append(&part, p, nl - p) != SB_OK ? SF_ERR_MEM
+                   : batch_line(args, &buff, part.data, part.len, &missing);
+                part.len = 0;
+            } else {
+                rc = batch_line(args, &buff, p, nl - p, &missing);
+            }
+            p = nl + 1;
+        }
+        if (rc == SF_OK && sb_append(&part, p, end - p) != SB_OK) {
+            rc = SF_ERR_MEM;
+        }
+    }
+    if (rc == SF_OK && n == 0 && part.len > 0) {
+        rc = batch_line(args, &buff, part.data, part.len, &missing); // No final newline
+    }
+    sb_free(&buff);
+    sb_free(&part);
+    sf_input_close(&in);
+
+    if (out_flush() != 0) {
+        fprintf(stderr, "Error: Failed writing output: %s\n", strerror(errno));
+        return 2;
+    }
+    if (rc == SF_ERR_MEM) {
+        fprintf(stderr, "Error: Failed to allocate memory for buffer.\n");
+        return 99;
+    }
+    if (n < 0) {
+        fprintf(stderr, "Error: Failed reading input: %s\n", strerror(errno));
+        return 2;
+    }
+    if (missing > 0) {
+        fprintf(stderr, "Error: Substring '%s' not found on %ld line(s).\n", args->old_sub, missing);
+        return 2;
+    }
+    return 0;
+}
+
+/*
+ * run_stream
+ *   Runs an operation over a file (or stdin when path is "-") without
+ *   loading it into the 50 byte style buffer.  Words are separated by any
+ *   ASCII whitespace, and the input is not padded or collapsed.
+ *     -c  prints "Word Count: N", counted on args->jobs threads
+ *     -F  prints the args->top most frequent words, on args->jobs threads
+ *     -w  prints the word listing
+ *     -x  writes the input with the first old_sub replaced by new_sub
+ *     -X  same as -x but replaces every occurrence
+ *     -m  writes the input with every rule of args->rules applied
+ *     -r  writes the input bytes in reverse order
+ *     -R  writes the input with the order of the words reversed
+ *   With args->utf8 the input is validated first, and -c, -w, -r and -R
+ *   work on characters and Unicode whitespace instead of bytes.
+ *   Returns the process exit code.
+ */
+int run_stream(const sf_args_t *args) {
+    const char *path = args->path;
+    char *old_sub = args->old_sub;
+    sf_input_t in;
+    const char *chunk;
+    ssize_t n;
+    int rc = SF_OK;
+
+    if (sf_input_open(&in, path) != 0) {
+        fprintf(stderr, "Error: Cannot open input '%s': %s\n", path, strerror(errno));
+        return 2;
+    }
+
+    switch (args->opt) {
+        case 'c': {
+            wc_state_t st = {0, false};
+            if (args->utf8) {
+                rc = stream_utf8(&in, utf8_count_piece, &st, &n);
+            } else if (args->jobs > 1) {
+                rc = stream_parallel(&in, count_par, &st, args->jobs, &n);
+            } else {
+                while ((n = sf_input_next(&in, &chunk)) > 0) {
+                    wc_feed(&st, chunk, n);
+                }
+            }
+            if (n == 0 && rc == SF_OK) {
+                out_str("Word Count: ");
+                out_long(st.words);
+                out_putc('\n');
+            }
+            break;
+        }
+
+        case 'F': {
+            freq_state_t fs;
+            if (freq_begin(&fs) != SF_OK) {
+                rc = SF_ERR_MEM;
+                n = 0;
+                break;
+            }
+            if (args->jobs > 1) {
+                rc = stream_parallel(&in, freq_par, &fs, args->jobs, &n);
+            } else {
+                while (rc == SF_OK && (n = sf_input_next(&in, &chunk)) > 0) {
+                    rc = freq_feed(&fs, chunk, n);
+                }
+            }
+            if (rc == SF_OK) {
+                rc = freq_end(&fs);
+            }
+            if (rc == SF_OK && n == 0) {
+                rc = freq_print_top(&fs.tab, args->top);
+            }
+            freq_free(&fs);
+            break;
+        }
+
+        case 'w': {
+            words_state_t ws;
+            words_begin(&ws, false);
+            if (args->utf8) {
+                rc = stream_utf8(&in, utf8_words_piece, &ws, &n);
+            } else {
+                while ((n = sf_input_next(&in, &chunk)) > 0) {
+                    words_feed(&ws, chunk, n);
+                }
+            }
+            words_end(&ws);
+            break;
+        }
+
+        case 'x':
+        case 'X': {
+            replace_state_t rs;
+            if (replace_begin(&rs, old_sub, args->new_sub, args->opt == 'X') != SB_OK) {
+                rc = SF_ERR_MEM;
+                n = 0;
+                break;
+            }
+            while (rc == SF_OK && (n = sf_input_next(&in, &chunk)) > 0) {
+                rc = replace_feed(&rs, chunk, n);
+            }
+            replace_end(&rs);
+            if (rc == SF_OK && rs.matches == 0) {
+                rc = SF_ERR_NOT_FOUND;
+            }
+            break;
+        }
+
+        case 'm': {
+            multi_state_t ms;
+            if (multi_begin(&ms, args->rules, NULL) != SF_OK) {
+                rc = SF_ERR_MEM;
+                n = 0;
+                break;
+            }
+            while (rc == SF_OK && (n = sf_input_next(&in, &chunk)) > 0) {
+                rc = multi_feed(&ms, chunk, n);
+            }
+            if (multi_end(&ms) != SF_OK) {
+                rc = SF_ERR_MEM;
+            }
+            break;
+        }
+
+        case 'r':
+        case 'R':
+            rc = stream_reverse(&in, args->opt == 'R', args->utf8);
+            n = 0;
+            break;
+
+        default:
+            sf_input_close(&in);
+            return 1;
+    }
+    sf_input_close(&in);
+    if (out_flush() != 0) {
+        fprintf(stderr, "Error: Failed writing output: %s\n", strerror(errno));
+        return 2;
+    }
+
+    if (n < 0) {
+        fprintf(stderr, "Error: Failed reading input: %s\n", strerror(errno));
+        return 2;
+    }
+    if (rc == SF_ERR_NOT_FOUND) {
+        fprintf(stderr, "Error: Substring '%s' not found.\n", old_sub);
+        return 2;
+    }
+    if (rc == SF_ERR_FORMAT) {
+        fprintf(stderr, "Error: Input is not valid UTF-8.\n");
+        return 2;
+    }
+    if (rc == SF_ERR_MEM) {
+        fprintf(stderr, "Error: Failed to allocate memory for buffer.\n");
+        return 99;
+    }
+    return 0;
+}
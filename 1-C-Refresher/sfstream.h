@@ -0,0 +1,69 @@
+#ifndef __SFSTREAM_H__
+#define __SFSTREAM_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+#include "sfmulti.h"
+#include "strbuf.h"
+
+// Read size for pipes and other inputs that cannot be mapped
+#define SF_CHUNK_SZ     (256 * 1024)
+
+// Names used on the command line for the streaming inputs
+#define SF_FILE_OPT     "-f"
+#define SF_STDIN_ARG    "-"
+#define SF_JOBS_OPT     "-j"
+#define SF_BATCH_OPT    "-b"
+
+// Input source for the streaming mode.  A regular file is mapped with mmap
+// and handed out as a single chunk, anything else (pipes, terminals) is read
+// in SF_CHUNK_SZ pieces into buf, so memory use stays constant.
+typedef struct sf_input {
+    int         fd;
+    bool        mapped;
+    const char *map;        // whole file when mapped
+    size_t      map_len;
+    bool        map_done;   // the mapping was already handed out
+    char       *buf;        // read buffer when not mapped
+} sf_input_t;
+
+int     sf_input_open(sf_input_t *in, const char *path);
+ssize_t sf_input_next(sf_input_t *in, const char **chunk);
+void    sf_input_close(sf_input_t *in);
+
+// Replacement over a stream, of the first occurrence or of all of them.
+// carry holds the tail of the previous chunk that could still be the start
+// of a match.
+typedef struct replace_state {
+    const char *old_sub;
+    size_t      old_len;
+    const char *new_sub;
+    size_t      new_len;
+    bool        all;        // replace every occurrence
+    bool        done;       // nothing more to replace
+    long        matches;
+    strbuf_t    carry;
+} replace_state_t;
+
+int  replace_begin(replace_state_t *rs, const char *old_sub, const char *new_sub, bool all);
+int  replace_feed(replace_state_t *rs, const char *data, size_t len);
+void replace_end(replace_state_t *rs);
+
+// Everything the command line says about a streaming run
+typedef struct sf_args {
+    char        opt;        // operation, c F r R w x X or m
+    const char *path;       // input file, SF_STDIN_ARG for stdin
+    char       *old_sub;    // -x and -X arguments
+    char       *new_sub;
+    int         jobs;       // -j, threads for -c and -F
+    long        top;        // -F, number of words to print
+    bool        utf8;       // --utf8, for c r R and w
+    const rules_t *rules;   // -m, loaded rules file
+} sf_args_t;
+
+int  run_stream(const sf_args_t *args);
+int  run_batch(const sf_args_t *args);
+
+#endif
@@ -0,0 +1,223 @@
+#include <string.h>
+
+#include "sflib.h"
+#include "sfout.h"
+#include "sfsimd.h"
+#include "sfutf8.h"
+
+// Length of the sequence a lead byte starts, 0 if it cannot start one
+static size_t utf8_seq_len(unsigned char c) {
+    if (c < 0x80) {
+        return 1;
+    } else if (c >= 0xc2 && c <= 0xdf) {
+        return 2;
+    } else if (c >= 0xe0 && c <= 0xef) {
+        return 3;
+    } else if (c >= 0xf0 && c <= 0xf4) {
+        return 4;
+    }
+    return 0;
+}
+
+// Decode one character of valid UTF-8, returns its length in bytes
+size_t utf8_decode(const char *p, uint32_t *cp) {
+    const unsigned char *s = (const unsigned char *)p;
+    size_t n = utf8_seq_len(s[0]);
+
+    switch (n) {
+        case 1:
+            *cp = s[0];
+            break;
+        case 2:
+            *cp = (s[0] & 0x1f) << 6 | (s[1] & 0x3f);
+            break;
+        case 3:
+            *cp = (s[0] & 0x0f) << 12 | (s[1] & 0x3f) << 6 | (s[2] & 0x3f);
+            break;
+        default:
+            *cp = (s[0] & 0x07) << 18 | (s[1] & 0x3f) << 12 | (s[2] & 0x3f) << 6 | (s[3] & 0x3f);
+            n = 4;
+            break;
+    }
+    return n;
+}
+
+// Unicode White_Space
+bool utf8_is_space(uint32_t cp) {
+    if (cp < 0x80) {
+        return IS_WORD_SEP((char)cp);
+    }
+    return cp == 0x85 || cp == 0xa0 || cp == 0x1680 ||
+           (cp >= 0x2000 && cp <= 0x200a) || cp == 0x2028 || cp == 0x2029 ||
+           cp == 0x202f || cp == 0x205f || cp == 0x3000;
+}
+
+// Code points that stay attached to the character before them
+static bool utf8_is_extend(uint32_t cp) {
+    return (cp >= 0x0300 && cp <= 0x036f) ||   // Combining diacritical marks
+           (cp >= 0x1ab0 && cp <= 0x1aff) ||
+           (cp >= 0x1dc0 && cp <= 0x1dff) ||
+           (cp >= 0x20d0 && cp <= 0x20ff) ||   // Combining marks for symbols
+           (cp >= 0xfe20 && cp <= 0xfe2f) ||   // Combining half marks
+           (cp >= 0xfe00 && cp <= 0xfe0f) ||   // Variation selectors
+           (cp >= 0x1f3fb && cp <= 0x1f3ff) || // Skin tone modifiers
+           (cp >= 0xe0020 && cp <= 0xe007f) || // Tags
+           cp == 0x200d;                       // Zero width joiner
+}
+
+// Count words, continuing the in_word state like the ASCII kernels
+long utf8_count_words(const char *data, size_t len, bool *in_word) {
+    bool iw = *in_word;
+    long words = 0;
+    size_t i = 0;
+
+    while (i < len) {
+        uint32_t cp;
+        i += utf8_decode(data + i, &cp);
+        if (utf8_is_space(cp)) {
+            iw = false;
+        } else if (!iw) {
+            words++;
+            iw = true;
+        }
+    }
+    *in_word = iw;
+    return words;
+}
+
+// Word listing with lengths in code points, see words_feed()
+void utf8_words_feed(words_state_t *ws, const char *data, size_t len) {
+    size_t i = 0;
+
+    while (i < len) {
+        uint32_t cp;
+        size_t n = utf8_decode(data + i, &cp);
+        if (utf8_is_space(cp)) {
+            if (ws->char_count > 0) {
+                out_str(" (");
+                out_long(ws->char_count);
+                out_str(")\n");
+                ws->char_count = 0;
+                ws->word_count++;
+            }
+        } else if (cp != PAD_CHAR || !ws->skip_pad) {
+            if (ws->char_count == 0) {
+                out_long(ws->word_count + 1);
+                out_str(". ");
+            }
+            out_write(data + i, n);
+            ws->char_count++;
+        }
+        i += n;
+    }
+}
+
+// Reverse by grapheme clusters: the bytes of each cluster are reversed in
+// place first, then the whole string, which puts every cluster back in
+// order at its new position
+void utf8_reverse(char *data, size_t len) {
+    rev_kernel_fn rev = rev_kernel();
+    size_t i = 0;
+
+    while (i < len) {
+        size_t start = i;
+        uint32_t cp;
+        bool join = false;
+
+        i += utf8_decode(data + i, &cp);
+        while (i < len) {
+            uint32_t next;
+            size_t n = utf8_decode(data + i, &next);
+            if (!join && !utf8_is_extend(next)) {
+                break;
+            }
+            join = (next == 0x200d); // A joiner pulls in the next character
+            i += n;
+        }
+        rev(data + start, i - start);
+    }
+    rev(data, len);
+}
+
+// Reverse the order of words, separated by Unicode whitespace.  Same trick
+// as utf8_reverse(), each word and separator run is reversed first.
+void utf8_reverse_words(char *data, size_t len) {
+    rev_kernel_fn rev = rev_kernel();
+    size_t i = 0;
+
+    while (i < len) {
+        size_t start = i;
+        uint32_t cp;
+        i += utf8_decode(data + i, &cp);
+        bool space = utf8_is_space(cp);
+        while (i < len) {
+            size_t n = utf8_decode(data + i, &cp);
+            if (utf8_is_space(cp) != space) {
+                break;
+            }
+            i += n;
+        }
+        rev(data + start, i - start);
+    }
+    rev(data, len);
+}
+
+/*
+ * utf8_stream_feed
+ *   Validates a chunk with the vector validator and passes it on to fn.  A
+ *   sequence cut off at the end of the chunk is kept in us->part, and once
+ *   the next chunk completes it, it is validated and passed on by itself.
+ *   Returns SF_OK, SF_ERR_FORMAT for invalid UTF-8, or what fn returned.
+ */
+int utf8_stream_feed(utf8_stream_t *us, const char *data, size_t len,
+                     utf8_piece_fn fn, void *ctx) {
+    size_t i = 0;
+    int rc;
+
+    if (us->part_len > 0) {
+        size_t need = utf8_seq_len(us->part[0]) - us->part_len;
+        size_t take = need < len ? need : len;
+        memcpy(us->part + us->part_len, data, take);
+        us->part_len += take;
+        i = take;
+        if (take < need) {
+            return SF_OK;
+        }
+        if (utf8_check_scalar(us->part, us->part_len) == UTF8_INVALID) {
+            return SF_ERR_FORMAT;
+        }
+        if ((rc = fn(ctx, us->part, us->part_len, false)) != SF_OK) {
+            return rc;
+        }
+        us->part_len = 0;
+    }
+
+    // Hold back a sequence that runs past the end of the chunk
+    size_t end = len;
+    for (size_t back = 1; back <= 3 && back <= len - i; back++) {
+        unsigned char c = data[len - back];
+        if ((c & 0xc0) == 0x80) {
+            continue; // Continuation byte, the lead is further back
+        }
+        if (utf8_seq_len(c) > back) {
+            end = len - back;
+        }
+        break;
+    }
+
+    int check = utf8_kernel()(data + i, end - i);
+    if (check == UTF8_INVALID) {
+        return SF_ERR_FORMAT;
+    }
+    if (end > i && (rc = fn(ctx, data + i, end - i, check == UTF8_ASCII)) != SF_OK) {
+        return rc;
+    }
+    memcpy(us->part, data + end, len - end);
+    us->part_len = len - end;
+    return SF_OK;
+}
+
+// The input must not end in the middle of a character
+int utf8_stream_end(utf8_stream_t *us) {
+    return us->part_len > 0 ? SF_ERR_FORMAT : SF_OK;
+}
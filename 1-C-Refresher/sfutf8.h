@@ -0,0 +1,39 @@
+#ifndef __SFUTF8_H__
+#define __SFUTF8_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "sflib.h"
+
+// --utf8 goes before the operation: stringfun --utf8 -c "string"
+#define SF_UTF8_OPT     "--utf8"
+
+// Operations that understand UTF-8.  Input must already be validated.
+// Separators are the ASCII whitespace plus the Unicode White_Space code
+// points, lengths count code points, and reversal keeps grapheme clusters
+// (a character followed by its combining marks, variation selectors, skin
+// tone modifiers or zero width joiner sequences) together.
+bool   utf8_is_space(uint32_t cp);
+size_t utf8_decode(const char *p, uint32_t *cp);
+long   utf8_count_words(const char *data, size_t len, bool *in_word);
+void   utf8_words_feed(words_state_t *ws, const char *data, size_t len);
+void   utf8_reverse(char *data, size_t len);
+void   utf8_reverse_words(char *data, size_t len);
+
+// Validation of a stream of chunks.  A character cut by the end of a chunk
+// is held in part until the next one, so the callback only ever sees whole
+// characters, along with whether the piece is pure ASCII.
+typedef int (*utf8_piece_fn)(void *ctx, const char *data, size_t len, bool ascii);
+
+typedef struct utf8_stream {
+    char   part[4];
+    size_t part_len;
+} utf8_stream_t;
+
+int utf8_stream_feed(utf8_stream_t *us, const char *data, size_t len,
+                     utf8_piece_fn fn, void *ctx);
+int utf8_stream_end(utf8_stream_t *us);
+
+#endif
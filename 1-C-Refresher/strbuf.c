@@ -0,0 +1,78 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "strbuf.h"
+
+// Initialize an empty buffer with room for at least cap bytes
+int sb_init(strbuf_t *sb, size_t cap) {
+    sb->data = NULL;
+    sb->len = 0;
+    sb->cap = 0;
+    return sb_reserve(sb, cap);
+}
+
+// Make sure the buffer can hold at least cap bytes, doubling the capacity
+// until it does so repeated small reserves stay amortized O(1)
+int sb_reserve(strbuf_t *sb, size_t cap) {
+    if (cap <= sb->cap) {
+        return SB_OK;
+    }
+
+    size_t new_cap = sb->cap ? sb->cap : SB_MIN_CAP;
+    while (new_cap < cap) {
+        if (new_cap > (size_t)-1 / 2) { // Doubling would overflow
+            new_cap = cap;
+            break;
+        }
+        new_cap *= 2;
+    }
+
+    char *data = realloc(sb->data, new_cap);
+    if (data == NULL) {
+        return SB_ERR_MEM;
+    }
+    sb->data = data;
+    sb->cap = new_cap;
+    return SB_OK;
+}
+
+// Append n bytes from src
+int sb_append(strbuf_t *sb, const char *src, size_t n) {
+    if (sb_reserve(sb, sb->len + n) != SB_OK) {
+        return SB_ERR_MEM;
+    }
+    memcpy(sb->data + sb->len, src, n);
+    sb->len += n;
+    return SB_OK;
+}
+
+// Append a single byte
+int sb_putc(strbuf_t *sb, char c) {
+    if (sb->len == sb->cap && sb_reserve(sb, sb->len + 1) != SB_OK) {
+        return SB_ERR_MEM;
+    }
+    sb->data[sb->len++] = c;
+    return SB_OK;
+}
+
+// Append n copies of c
+int sb_fill(strbuf_t *sb, char c, size_t n) {
+    if (sb_reserve(sb, sb->len + n) != SB_OK) {
+        return SB_ERR_MEM;
+    }
+    memset(sb->data + sb->len, c, n);
+    sb->len += n;
+    return SB_OK;
+}
+
+// Drop the contents but keep the allocation for reuse
+void sb_clear(strbuf_t *sb) {
+    sb->len = 0;
+}
+
+void sb_free(strbuf_t *sb) {
+    free(sb->data);
+    sb->data = NULL;
+    sb->len = 0;
+    sb->cap = 0;
+}
@@ -0,0 +1,30 @@
+#ifndef __STRBUF_H__
+#define __STRBUF_H__
+
+#include <stddef.h>
+
+// Growable byte buffer used by every stringfun operation.  data is not NUL
+// terminated, len is the number of bytes in use and cap the number of bytes
+// allocated.  Growth is geometric so appending n bytes one at a time costs
+// O(n) overall.
+typedef struct strbuf {
+    char   *data;
+    size_t  len;
+    size_t  cap;
+} strbuf_t;
+
+#define SB_MIN_CAP 64
+
+// Return codes
+#define SB_OK        0
+#define SB_ERR_MEM  -1
+
+int  sb_init(strbuf_t *sb, size_t cap);
+int  sb_reserve(strbuf_t *sb, size_t cap);
+int  sb_append(strbuf_t *sb, const char *src, size_t n);
+int  sb_putc(strbuf_t *sb, char c);
+int  sb_fill(strbuf_t *sb, char c, size_t n);
+void sb_clear(strbuf_t *sb);
+void sb_free(strbuf_t *sb);
+
+#endif
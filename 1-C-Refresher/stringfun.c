@@ -2,231 +2,69 @@
 #include <stdlib.h>
 #include <stdbool.h>
 #include <string.h>
+#include <errno.h>
 
-#define BUFFER_SZ 50
+#include "sffreq.h"
+#include "sflib.h"
+#include "sfmulti.h"
+#include "sfout.h"
+#include "sfsimd.h"
+#include "sfstream.h"
+#include "sfutf8.h"
 
 // Function prototypes
 void usage(char *);                                 // Displays the usage instructions for the program
-void print_buff(char *, int);                       // Prints the contents of the buffer
-int setup_buff(char *, char *, int);                // Sets up the buffer with the input string and padding
-int count_words(char *, int, int);                  // Counts the number of words in the buffer
-void reverse_string(char *, int);                   // Reverses the string in the buffer
-void print_words_with_length(char *, int, int);     // Prints each word and its length
-int replace_substring(char *, char *, char *, int); // Replaces a substring in the buffer with another substring
 
-// Setup buffer with padding
-int setup_buff(char *buff, char *user_str, int len) {
-    int str_len = 0;
-    char *src = user_str;
-    char *dest = buff;
-    bool at_space = true; // Tracks consecutive spaces
-
-    // Process the input string and copy into the buffer
-    while (*src && str_len < len) {
-        if (*src == ' ') {
-            if (!at_space) { // Only copy a single space
-                *dest++ = ' ';
-                str_len++;
-            }
-            at_space = true;
-        } else {
-            *dest++ = *src; // Copy non-space character
-            str_len++;
-            at_space = false;
-        }
-        src++;
-    }
-
-    // Handle trailing spaces
-    if (str_len > 0 && *(dest - 1) == ' ') {
-        dest--;
-        str_len--;
-    }
-
-    // Check if the input string exceeds the buffer size
-    if (*src) {
-        fprintf(stderr, "Error: Input string exceeds buffer size.\n");
-        return -1;
-    }
-
-    // Pad the remaining buffer with '.'
-    while (str_len < len) {
-        *dest++ = '.';
-        str_len++;
-    }
-
-    return str_len;
-}
-
-// Print the buffer
-void print_buff(char *buff, int len) {
-    printf("Buffer:  [");
-    for (int i = 0; i < len; i++) {
-        putchar(*(buff + i)); // Print each character in the buffer
-    }
-    printf("]\n");
-}
+// The buffer operations live in sflib.c and work on a growable strbuf_t, so
+// strings of any length are handled without truncation.
 
 // Display usage instructions
 void usage(char *exename) {
-    printf("usage: %s [-h|c|r|w|x] \"string\" [other args]\n", exename);
-}
-
-// Count words in the buffer
-int count_words(char *buff, int len, int str_len) {
-    (void)len; // Suppress unused parameter warning
-    bool at_start = true;
-    int word_count = 0;
-
-    for (int i = 0; i < str_len; i++) {
-        char c = *(buff + i); // Get the current character
-        if (c == ' ') {
-            at_start = true; // Set start flag to true when encountering a space
-        } else if (at_start) {
-            word_count++;
-            at_start = false; // Set start flag to false
-        }
-    }
-    return word_count;
-}
-
-// Reverse the string
-void reverse_string(char *buff, int str_len) {
-    char *start = buff;
-    char *end = buff + str_len - 1;
-
-    // Reverse only the valid string content (ignoring the dots at first)
-    while (start < end) {
-        char temp = *start;
-        *start = *end;  // Swap the characters
-        *end = temp;    // Assign the held character to the opposite end
-        start++;
-        end--;
-    }
-
-    // Move all dots to the end of the buffer
-    char temp_buffer[BUFFER_SZ];
-    int temp_index = 0;
-
-    // Copy non-dot characters into temp_buffer
-    for (int i = 0; i < str_len; i++) {
-        if (buff[i] != '.') {
-            temp_buffer[temp_index++] = buff[i];
-        }
-    }
-
-    // Fill the rest of temp_buffer with dots
-    while (temp_index < BUFFER_SZ) {
-        temp_buffer[temp_index++] = '.';
-    }
-
-    // Copy back to the original buffer
-    for (int i = 0; i < BUFFER_SZ; i++) {
-        buff[i] = temp_buffer[i];
+    static const char *const forms[] = {
+        "[-h|c|r|R|w|x|X] \"string\" [other args]",
+        "[-c|r|R|w|x|X] [-f file | -] [other args]",
+        "-c [-j N] [-f file | -]",
+        "-F [topN] [-j N] [\"string\" | -f file | -]",
+        "-m rules-file [\"string\" | -f file | -]",
+        "--utf8 [-c|r|R|w] [\"string\" | -f file | -]",
+        "-b [-c|r|R|w|x old new] < lines",
+    };
+
+    for (size_t i = 0; i < sizeof(forms) / sizeof(forms[0]); i++) {
+        out_str(i == 0 ? "usage: " : "       ");
+        out_str(exename);
+        out_putc(SPACE_CHAR);
+        out_str(forms[i]);
+        out_putc('\n');
     }
 }
 
-// Print words with their lengths
-void print_words_with_length(char *buff, int len, int str_len) {
-    (void)len; // Suppress unused parameter warning
-    bool at_start = true;
-    int char_count = 0;
-    int word_count = 0;
-
-    printf("Word Print\n----------\n");
-    for (int i = 0; i < str_len; i++) {
-        char c = *(buff + i);
-        if (c == ' ') {
-            if (!at_start) {
-                printf(" (%d)\n", char_count); // Print length of the word and move to next line
-                char_count = 0;              // Reset the character counter
-                word_count++;
-            }
-            at_start = true;
-        } else if (c != '.') { // Ignore padding dots
-            if (at_start) {
-                at_start = false;
-                printf("%d. %c", word_count + 1, c); // Print word number and first character
-            } else {
-                printf("%c", c); // Print subsequent characters of the word
-            }
-            char_count++;
-        }
-    }
-
-    if (char_count > 0) {
-        printf(" (%d)\n", char_count); // Print the length of the last word
-        word_count++;
-    }
-}
-
-// Replace a substring with another substring
-int replace_substring(char *buff, char *old_sub, char *new_sub, int len) {
-    (void)len; // Suppress unused parameter warning
-    char temp[BUFFER_SZ];
-    char *src = buff;
-    char *dest = temp;
-    char *pos = NULL;
-
-    // Find the first occurrence of old_sub in buff
-    while (*src) {
-        if (strncmp(src, old_sub, strlen(old_sub)) == 0) {
-            pos = src;
-            break;
-        }
-        src++;
-    }
-
-    if (!pos) {
-        return -1; // Substring not found
-    }
-
-    // Copy characters before the old substring
-    src = buff;
-    while (src < pos && dest < temp + BUFFER_SZ - 1) {
-        *dest++ = *src++;
-    }
-
-    // Copy the new substring
-    char *new_sub_ptr = new_sub;
-    while (*new_sub_ptr && dest < temp + BUFFER_SZ - 1) {
-        *dest++ = *new_sub_ptr++;
-    }
-
-    // Copy characters after the old substring
-    src += strlen(old_sub);
-    while (*src && dest < temp + BUFFER_SZ - 1) {
-        *dest++ = *src++;
-    }
-
-    // Null-terminate the resulting string
-    *dest = '\0';
-
-    // Check for truncation
-    if (dest - temp >= BUFFER_SZ) {
-        fprintf(stderr, "Warning: Replacement caused truncation of the buffer.\n");
-        return -2;
-    }
-
-    // Copy temp back to buff
-    char *temp_ptr = temp;
-    char *buff_ptr = buff;
-    while (*temp_ptr && buff_ptr < buff + BUFFER_SZ - 1) {
-        *buff_ptr++ = *temp_ptr++;
-    }
-
-    // Null-terminate buff
-    *buff_ptr = '\0';
-
-    return 0;
-}
-
 int main(int argc, char *argv[]) {
-    char *buff;             // Placeholder for the internal buffer
+    strbuf_t buff;          // The internal buffer, grows to fit the input
     char *input_string;     // Holds the string provided by the user on cmd line
     char opt;               // Used to capture user option from cmd line
-    int rc;                 // Used for return codes
-    int user_str_len;       // Length of user supplied string
+    long rc;                // Used for return codes
+    ssize_t user_str_len;   // Length of user supplied string
+
+    atexit(out_exit); // Buffered output is written on every exit path
+
+    // --utf8 comes first, drop it so the option is argv[1] as usual
+    bool utf8 = false;
+    if (argc > 1 && strcmp(argv[1], SF_UTF8_OPT) == 0) {
+        utf8 = true;
+        argv[1] = argv[0];
+        argv++;
+        argc--;
+    }
+
+    // -b runs the operation on every line of stdin, drop it the same way
+    bool batch = false;
+    if (argc > 1 && strcmp(argv[1], SF_BATCH_OPT) == 0) {
+        batch = true;
+        argv[1] = argv[0];
+        argv++;
+        argc--;
+    }
 
     // TODO: #1. WHY IS THIS SAFE, aka what if argv[1] does not exist?
     // This condition ensures safety:
@@ -245,6 +83,22 @@ int main(int argc, char *argv[]) {
         usage(argv[0]);
         exit(0);
     }
+    if (utf8 && (opt == '\0' || strchr("crRw", opt) == NULL)) {
+        usage(argv[0]); // Only these operations know about UTF-8
+        exit(1);
+    }
+    if (batch) {
+        sf_args_t args = { .opt = opt, .path = SF_STDIN_ARG };
+        if (utf8 || opt == '\0' || strchr("crRwx", opt) == NULL || argc != (opt == 'x' ? 4 : 2)) {
+            usage(argv[0]);
+            exit(1);
+        }
+        if (opt == 'x') {
+            args.old_sub = argv[2];
+            args.new_sub = argv[3];
+        }
+        exit(run_batch(&args));
+    }
 
     // TODO: #2 Document the purpose of the if statement below
     // This condition checks if the user provided a string argument (argv[2]) alongside the option flag.
@@ -257,70 +111,214 @@ int main(int argc, char *argv[]) {
         exit(1);
     }
 
-    input_string = argv[2];
+    // -m takes the rules file before the input.  Rules that do not parse
+    // are reported by line number.
+    rules_t rules = {0};
+    int first = 2; // Index of the input argument
+    if (opt == 'm') {
+        long bad_line = 0;
+        if (argc < 4) {
+            usage(argv[0]);
+            exit(1);
+        }
+        rc = rules_load(&rules, argv[2], &bad_line);
+        if (rc == SF_ERR_IO) {
+            fprintf(stderr, "Error: Cannot read rules '%s': %s\n", argv[2], strerror(errno));
+            exit(2);
+        } else if (rc == SF_ERR_FORMAT) {
+            fprintf(stderr, "Error: %s line %ld: expected old%snew\n", argv[2], bad_line, SF_RULE_SEP);
+            exit(1);
+        } else if (rc == SF_ERR_MEM) {
+            fprintf(stderr, "Error: Failed to allocate memory for buffer.\n");
+            exit(99);
+        }
+        first = 3;
+    }
+
+    // -F takes an optional count before the input
+    long top = FREQ_DEF_TOP;
+    if (opt == 'F' && argc > 3 && argv[2][strspn(argv[2], "0123456789")] == '\0') {
+        top = atol(argv[2]);
+        first = 3;
+    }
+
+    // Streaming mode: read a file with -f, or stdin with -, instead of
+    // taking the string from the command line.  -j N first counts on N
+    // threads.
+    int arg = first;
+    int jobs = 1;
+    if (strcmp(argv[arg], SF_JOBS_OPT) == 0) {
+        if (argc < arg + 3 || (jobs = atoi(argv[arg + 1])) < 1 || (opt != 'c' && opt != 'F') || utf8) {
+            usage(argv[0]);
+            exit(1);
+        }
+        arg += 2;
+    }
+    if (strcmp(argv[arg], SF_FILE_OPT) == 0 || strcmp(argv[arg], SF_STDIN_ARG) == 0) {
+        sf_args_t args = { .opt = opt, .path = SF_STDIN_ARG, .jobs = jobs, .top = top, .utf8 = utf8,
+                           .rules = &rules };
+        if (strcmp(argv[arg++], SF_FILE_OPT) == 0) {
+            if (argc < arg + 1) {
+                usage(argv[0]);
+                exit(1);
+            }
+            args.path = argv[arg++];
+        }
+        if (opt == 'x' || opt == 'X') {
+            if (argc < arg + 2) {
+                fprintf(stderr, "Error: Replace option requires two additional arguments.\n");
+                exit(1);
+            }
+            args.old_sub = argv[arg];
+            args.new_sub = argv[arg + 1];
+        }
+        if (opt == '\0' || strchr("cFrRwxXm", opt) == NULL) {
+            usage(argv[0]);
+            exit(1);
+        }
+        rc = run_stream(&args);
+        rules_free(&rules);
+        exit(rc);
+    }
+    if (arg != first) {
+        usage(argv[0]); // -j needs a file or stdin
+        exit(1);
+    }
+
+    input_string = argv[first];
+
+    // Pure ASCII input takes the byte paths, they give the same results
+    if (utf8) {
+        int check = utf8_kernel()(input_string, strlen(input_string));
+        if (check == UTF8_INVALID) {
+            fprintf(stderr, "Error: Input is not valid UTF-8.\n");
+            exit(2);
+        }
+        utf8 = (check == UTF8_VALID);
+    }
 
     // TODO: #3 Allocate space for the buffer using malloc and
     //       handle error if malloc fails by exiting with a return code of 99
-    buff = (char *)malloc(BUFFER_SZ * sizeof(char));
-    if (buff == NULL) {
+    if (sb_init(&buff, BUFFER_SZ) != SB_OK) {
         fprintf(stderr, "Error: Failed to allocate memory for buffer.\n");
         exit(99);
     }
 
-    user_str_len = setup_buff(buff, input_string, BUFFER_SZ); // Setup the buffer
+    user_str_len = setup_buff(&buff, input_string, BUFFER_SZ); // Setup the buffer
     if (user_str_len < 0) {
-        fprintf(stderr, "Error setting up buffer, error = %d\n", user_str_len);
-        free(buff); // Free allocated memory before exiting
-        exit(2);
+        fprintf(stderr, "Error: Failed to allocate memory for buffer.\n");
+        sb_free(&buff); // Free allocated memory before exiting
+        exit(99);
     }
 
     switch (opt) {
         case 'c': // Handle word count
-            rc = count_words(buff, BUFFER_SZ, user_str_len);
+            if (utf8) {
+                bool in_word = false;
+                rc = utf8_count_words(buff.data, user_str_len, &in_word);
+            } else {
+                rc = count_words(buff.data, buff.len, user_str_len);
+            }
             if (rc < 0) {
-                fprintf(stderr, "Error counting words, rc = %d\n", rc);
-                free(buff); // Free allocated memory before exiting
+                fprintf(stderr, "Error counting words, rc = %ld\n", rc);
+                sb_free(&buff); // Free allocated memory before exiting
                 exit(2);
             }
-            printf("Word Count: %d\n", rc);
-            print_buff(buff, BUFFER_SZ); // Print buffer here
+            out_str("Word Count: ");
+            out_long(rc);
+            out_putc('\n');
+            print_buff(&buff); // Print buffer here
             break;
 
         case 'r': // Reverse the string
-            reverse_string(buff, user_str_len);
-            print_buff(buff, BUFFER_SZ); // Print buffer here
+            if (utf8) {
+                utf8_reverse(buff.data, user_str_len); // By grapheme cluster
+                move_pad_to_end(buff.data, user_str_len);
+            } else {
+                reverse_string(buff.data, user_str_len);
+            }
+            print_buff(&buff); // Print buffer here
+            break;
+
+        case 'R': // Reverse the order of the words
+            if (utf8) {
+                utf8_reverse_words(buff.data, user_str_len);
+            } else {
+                reverse_words(buff.data, user_str_len);
+            }
+            print_buff(&buff); // Print buffer here
             break;
 
         case 'w': // Print words and their lengths
-            print_words_with_length(buff, BUFFER_SZ, user_str_len); // Prints buffer internally
+            if (utf8) {
+                words_state_t ws;
+                words_begin(&ws, true);
+                utf8_words_feed(&ws, buff.data, user_str_len);
+                words_end(&ws);
+            } else {
+                print_words_with_length(buff.data, buff.len, user_str_len); // Prints buffer internally
+            }
             break;
 
-        case 'x': {
+        case 'x':   // Replace the first occurrence
+        case 'X': { // Replace every occurrence
             if (argc < 5) {
                 fprintf(stderr, "Error: Replace option requires two additional arguments.\n");
-                free(buff);
+                sb_free(&buff);
                 exit(1);
             }
             char *old_sub = argv[3];
             char *new_sub = argv[4];
-            int result = replace_substring(buff, old_sub, new_sub, BUFFER_SZ);
-            if (result == -1) {
+            ssize_t result = (opt == 'x')
+                ? replace_substring(&buff, user_str_len, old_sub, new_sub, BUFFER_SZ)
+                : replace_all(&buff, user_str_len, old_sub, new_sub, BUFFER_SZ);
+            if (result == SF_ERR_NOT_FOUND) {
                 fprintf(stderr, "Error: Substring '%s' not found.\n", old_sub);
-                free(buff);
+                sb_free(&buff);
                 exit(2);
-            } else if (result == -2) {
-                fprintf(stderr, "Warning: Replacement caused truncation of the buffer.\n");
+            } else if (result == SF_ERR_MEM) {
+                fprintf(stderr, "Error: Failed to allocate memory for buffer.\n");
+                sb_free(&buff);
+                exit(99);
             }
-            print_buff(buff, BUFFER_SZ); // Print buffer here
+            print_buff(&buff); // Print buffer here
             break;
         }
+        case 'F': { // Most frequent words
+            freq_state_t fs;
+            if (freq_begin(&fs) != SF_OK || freq_feed(&fs, buff.data, user_str_len) != SF_OK ||
+                freq_end(&fs) != SF_OK || freq_print_top(&fs.tab, top) != SF_OK) {
+                fprintf(stderr, "Error: Failed to allocate memory for buffer.\n");
+                freq_free(&fs);
+                sb_free(&buff);
+                exit(99);
+            }
+            freq_free(&fs);
+            break;
+        }
+
+        case 'm': // Apply every rule from the rules file
+            if (replace_rules(&buff, user_str_len, &rules, BUFFER_SZ) < 0) {
+                fprintf(stderr, "Error: Failed to allocate memory for buffer.\n");
+                sb_free(&buff);
+                rules_free(&rules);
+                exit(99);
+            }
+            rules_free(&rules);
+            print_buff(&buff);
+            break;
+
         default:
             usage(argv[0]);
-            free(buff);
+            sb_free(&buff);
             exit(1);
     }
 
-    free(buff); // Free allocated memory
+    sb_free(&buff); // Free allocated memory
+    if (out_flush() != 0) {
+        fprintf(stderr, "Error: Failed writing output: %s\n", strerror(errno));
+        exit(2);
+    }
     exit(0);
 }
 
@@ -3,19 +3,19 @@
 @test "no args shows usage" {
     run ./stringfun
     [ "$status" -eq 1 ]
-    [ "${lines[0]}" = "usage: ./stringfun [-h|c|r|w|x] \"string\" [other args]" ]
+    [ "${lines[0]}" = "usage: ./stringfun [-h|c|r|R|w|x|X] \"string\" [other args]" ]
 }
 
 @test "bad args shows usage" {
     run ./stringfun -z "Bad arg usage"  
     [ "$status" -eq 1 ]
-    [ "${lines[0]}" = "usage: ./stringfun [-h|c|r|w|x] \"string\" [other args]" ]
+    [ "${lines[0]}" = "usage: ./stringfun [-h|c|r|R|w|x|X] \"string\" [other args]" ]
 }
 
 @test "check -h" {
     run ./stringfun -h
     [ "$status" -eq 0 ]
-    [ "${lines[0]}" = "usage: ./stringfun [-h|c|r|w|x] \"string\" [other args]" ]
+    [ "${lines[0]}" = "usage: ./stringfun [-h|c|r|R|w|x|X] \"string\" [other args]" ]
 }
 
 @test "wordcount" {
@@ -62,9 +62,16 @@ Buffer:  [Lets get a lot of words to test...................]" ]
     [ "$output" = "Buffer:  [krow dluohs taht gnirts htgnel mumixam eht si sihT]" ]
 }
 
-@test "check over max length" {
-    run ./stringfun -w "This is a string that does not work as it is too long"
-    [ "$status" -ne 0 ]
+@test "check over max length grows the buffer" {
+    run ./stringfun -r "This string is longer than fifty bytes so the buffer has to grow"
+    [ "$status" -eq 0 ]
+    [ "$output" = "Buffer:  [worg ot sah reffub eht os setyb ytfif naht regnol si gnirts sihT]" ]
+}
+
+@test "wordcount on a long string" {
+    run ./stringfun -c "$(printf 'word %.0s' $(seq 1 1000))"
+    [ "$status" -eq 0 ]
+    [ "${lines[0]}" = "Word Count: 1000" ]
 }
 
 
@@ -83,13 +90,13 @@ Buffer:  [Lets get a lot of words to test...................]" ]
 
 @test "basic overflow search replace" {
     run ./stringfun -x "This is a super long string for testing my program" testing  validating
-    [ "$output" = "Buffer:  [This is a super long string for validating my prog]" ] ||
+    [ "$output" = "Buffer:  [This is a super long string for validating my program]" ] ||
     [ "$output" = "Not Implemented!" ]
 }
 
 @test "test overflow string replace" {
     run ./stringfun -x "This is a super long string for testing my program" testing  validating
-    [ "$output" = "Buffer:  [This is a super long string for validating my prog]" ] ||
+    [ "$output" = "Buffer:  [This is a super long string for validating my program]" ] ||
     [ "$output" = "Not Implemented!" ]
 }
 
@@ -98,3 +105,187 @@ Buffer:  [Lets get a lot of words to test...................]" ]
     [ "$output" = "Buffer:  [This is a super long string for testing my app....]" ] || 
     [ "$output" = "Not Implemented!" ]
 }
+
+@test "stream wordcount from stdin" {
+    run bash -c "printf 'one two\tthree\nfour  five' | ./stringfun -c -"
+    [ "$status" -eq 0 ]
+    [ "$output" = "Word Count: 5" ]
+}
+
+@test "stream wordcount from file matches wc -w" {
+    seq 1 20000 | paste -sd ' ' > stream_in.txt
+    run ./stringfun -c -f stream_in.txt
+    expected=$(wc -w < stream_in.txt)
+    rm -f stream_in.txt
+    [ "$status" -eq 0 ]
+    [ "$output" = "Word Count: $expected" ]
+}
+
+@test "stream replace from stdin" {
+    run bash -c "printf 'This is a bad test' | ./stringfun -x - bad great"
+    [ "$status" -eq 0 ]
+    [ "$output" = "This is a great test" ]
+}
+
+@test "simd wordcount kernels match scalar" {
+    head -c 200000 /dev/urandom | tr -c 'a-z \t\n' ' ' > kern_in.txt
+    expected=$(SF_KERNEL=scalar ./stringfun -c -f kern_in.txt)
+    for k in sse2 avx2; do
+        run env SF_KERNEL=$k ./stringfun -c -f kern_in.txt
+        [ "$status" -eq 0 ]
+        [ "$output" = "$expected" ] || { rm -f kern_in.txt; false; }
+    done
+    rm -f kern_in.txt
+}
+
+@test "parallel wordcount matches single thread" {
+    seq 1 800000 | paste -sd ' ' > par_in.txt
+    expected=$(wc -w < par_in.txt)
+    run ./stringfun -c -j 4 -f par_in.txt
+    rm -f par_in.txt
+    [ "$status" -eq 0 ]
+    [ "$output" = "Word Count: $expected" ]
+}
+
+@test "parallel wordcount caps a large -j on a pipe" {
+    run bash -c "seq 1000 | ./stringfun -c -j 2000 -"
+    [ "$status" -eq 0 ]
+    [ "$output" = "Word Count: 1000" ]
+}
+
+@test "parallel wordcount requires stream input" {
+    run ./stringfun -c -j 2 "hello world"
+    [ "$status" -eq 1 ]
+}
+
+@test "replace all occurrences" {
+    run ./stringfun -X "the cat and the dog and the bird" the a
+    [ "$status" -eq 0 ]
+    [ "$output" = "Buffer:  [a cat and a dog and a bird........................]" ]
+}
+
+@test "replace all with longer text" {
+    run ./stringfun -X "ab ab ab" ab "a longer replacement"
+    [ "$status" -eq 0 ]
+    [ "$output" = "Buffer:  [a longer replacement a longer replacement a longer replacement]" ]
+}
+
+@test "stream replace all from stdin" {
+    run bash -c "printf 'one bad two bad three bad' | ./stringfun -X - bad good"
+    [ "$status" -eq 0 ]
+    [ "$output" = "one good two good three good" ]
+}
+
+@test "multi-pattern replace uses leftmost-longest match" {
+    printf 'he=>HE\nshe=>SHE\nhers=>HERS\n# comment\n\nhis=>\n' > rules_in.txt
+    run ./stringfun -m rules_in.txt "ushers and his sheep"
+    rm -f rules_in.txt
+    [ "$status" -eq 0 ]
+    [ "$output" = "Buffer:  [uSHErs and  SHEep.................................]" ]
+}
+
+@test "multi-pattern replace from stdin" {
+    printf 'secret=>[x]\npassword=>[x]\n' > rules_in.txt
+    run bash -c "printf 'user secret password ok' | ./stringfun -m rules_in.txt -"
+    rm -f rules_in.txt
+    [ "$status" -eq 0 ]
+    [ "$output" = "user [x] [x] ok" ]
+}
+
+@test "multi-pattern replace across pipe reads" {
+    printf 'ab=>X\nb=>Y\nxaby=>Z\n' > rules_in.txt
+    run bash -c "(printf 'xab'; sleep 0.2; printf 'y '; sleep 0.2; printf 'ab') | ./stringfun -m rules_in.txt -"
+    rm -f rules_in.txt
+    [ "$status" -eq 0 ]
+    [ "$output" = "Z X" ]
+}
+
+@test "multi-pattern replace rejects bad rules" {
+    printf 'good=>ok\nno separator\n' > rules_in.txt
+    run ./stringfun -m rules_in.txt "good"
+    rm -f rules_in.txt
+    [ "$status" -eq 1 ]
+    [ "$output" = "Error: rules_in.txt line 2: expected old=>new" ]
+}
+
+@test "reverse word order" {
+    run ./stringfun -R "the quick  brown fox"
+    [ "$status" -eq 0 ]
+    [ "$output" = "Buffer:  [fox brown quick the...............................]" ]
+}
+
+@test "simd reverse kernels match scalar" {
+    head -c 100000 /dev/urandom > rev_in.bin
+    expected=$(SF_KERNEL=scalar ./stringfun -r -f rev_in.bin | md5sum)
+    for k in ssse3 avx2; do
+        actual=$(SF_KERNEL=$k ./stringfun -r -f rev_in.bin | md5sum)
+        [ "$actual" = "$expected" ] || { rm -f rev_in.bin; false; }
+    done
+    rm -f rev_in.bin
+}
+
+@test "word frequency top N" {
+    run ./stringfun -F 2 "the cat the dog the end cat"
+    [ "$status" -eq 0 ]
+    [ "${lines[0]}" = "      3 the" ]
+    [ "${lines[1]}" = "      2 cat" ]
+    [ "${#lines[@]}" -eq 2 ]
+}
+
+@test "parallel word frequency matches sort uniq" {
+    seq 1 1000000 | sed 's/.*\(.\)$/w\1/' | paste -sd ' ' > freq_in.txt
+    expected=$(tr ' ' '\n' < freq_in.txt | sort | uniq -c | sort -k1,1nr -k2,2 | head -3)
+    run ./stringfun -F 3 -j 4 -f freq_in.txt
+    rm -f freq_in.txt
+    [ "$status" -eq 0 ]
+    [ "$output" = "$expected" ]
+}
+
+@test "buffered output reports write errors" {
+    run bash -c "./stringfun -c 'hello world' > /dev/full"
+    [ "$status" -eq 2 ]
+}
+
+@test "utf8 word count splits on unicode spaces" {
+    run ./stringfun --utf8 -c "héllo wörld　日本語 x"
+    [ "$status" -eq 0 ]
+    [ "${lines[0]}" = "Word Count: 4" ]
+}
+
+@test "utf8 reverse keeps combining marks with their letter" {
+    run bash -c "printf 'ae\xcc\x81 z' | ./stringfun --utf8 -r -"
+    [ "$status" -eq 0 ]
+    [ "$output" = "$(printf 'z e\xcc\x81a')" ]
+}
+
+@test "utf8 rejects invalid input" {
+    run bash -c "printf 'ab\xff cd' | ./stringfun --utf8 -c -"
+    [ "$status" -eq 2 ]
+    [ "$output" = "Error: Input is not valid UTF-8." ]
+}
+
+@test "batch mode runs the operation on every line" {
+    run bash -c "printf 'hello  world\nabc\n' | ./stringfun -b -c"
+    [ "$status" -eq 0 ]
+    [ "${lines[0]}" = "Word Count: 2" ]
+    [ "${lines[1]}" = "Buffer:  [hello world.......................................]" ]
+    [ "${lines[2]}" = "Word Count: 1" ]
+    [ "${lines[3]}" = "Buffer:  [abc...............................................]" ]
+}
+
+@test "batch replace keeps lines without a match" {
+    run bash -c "printf 'a b\nx\n' | ./stringfun -b -x b Q 2>/dev/null"
+    [ "$status" -eq 2 ]
+    [ "${lines[0]}" = "Buffer:  [a Q...............................................]" ]
+    [ "${lines[1]}" = "Buffer:  [x.................................................]" ]
+}
+
+@test "simd space squeezing kernels match scalar" {
+    input=$(head -c 3000 /dev/urandom | tr -c 'ab' ' ')
+    expected=$(SF_KERNEL=scalar ./stringfun -c "$input")
+    for k in ssse3 avx2 vbmi2; do
+        run env SF_KERNEL=$k ./stringfun -c "$input"
+        [ "$status" -eq 0 ]
+        [ "$output" = "$expected" ]
+    done
+}
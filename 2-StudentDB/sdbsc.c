@@ -1,14 +1,48 @@
+#define _GNU_SOURCE // O_TMPFILE and copy_file_range()
 #include <stdio.h>
 #include <stdlib.h>
 #include <fcntl.h> // C library for system call file routines
 #include <string.h>
+#include <errno.h>
+#include <sys/file.h>
+#include <sys/ioctl.h>
 #include <sys/stat.h>
+#include <linux/fs.h> // FICLONE
 #include <unistd.h>
 #include <stdbool.h>
+#include <time.h>
 
 // Database include files
 #include "db.h"
 #include "sdbsc.h"
+#include "slotdb.h"
+
+static int fixed_get(int fd, int id, db_rec_t *r);
+static int fixed_put(int fd, int id, char *fname, char *lname, int gpa);
+static int fixed_del(int fd, int id);
+static int fixed_scan(int fd, db_scan_fn fn, void *ctx);
+static int fixed_copy(int src_fd, int dst_fd);
+
+const db_ops_t FIXED_DB_OPS = {
+    "fixed", fixed_get, fixed_put, fixed_del, fixed_scan, fixed_copy
+};
+
+/*
+ *  db_ops_for
+ *      fd:  linux file descriptor of an open database
+ *
+ *  Picks the accessor table for the on-disk format of the database.  A
+ *  slotted db starts with SLOT_MAGIC, anything else (including an empty
+ *  file) is the fixed 64 byte record format.
+ *
+ *  returns:  pointer to FIXED_DB_OPS or SLOT_DB_OPS
+ *
+ *  console:  Does not produce any console I/O
+ */
+const db_ops_t *db_ops_for(int fd)
+{
+    return slot_is_slotted(fd) ? &SLOT_DB_OPS : &FIXED_DB_OPS;
+}
 
 /*
  *  open_db
@@ -47,6 +81,162 @@ int open_db(char *dbFile, bool should_truncate)
     return fd;
 }
 
+/*
+ *  db_lock
+ *      fd:    linux file descriptor of DB_FILE
+ *      how:   LOCK_SH or LOCK_EX
+ *
+ *  Writers hold LOCK_EX while they change the database, and a snapshot is
+ *  taken under LOCK_SH.  compress_db() and migrate_db() replace DB_FILE
+ *  with rename(), so a process that was waiting for the lock can wake up
+ *  holding a lock on the old, now unlinked, file.  After the lock is
+ *  granted the inode is compared with DB_FILE, and if they differ the live
+ *  file is opened and dup2()'d onto fd before locking again.  This way the
+ *  caller's fd always refers to the current database.
+ *
+ *  returns:  NO_ERROR       the lock is held on the live database
+ *            ERR_DB_FILE    database file I/O issue
+ *
+ *  console:  M_ERR_DB_OPEN  if DB_FILE could not be reopened
+ */
+int db_lock(int fd, int how)
+{
+    struct stat fd_st, path_st;
+
+    while (1)
+    {
+        if (flock(fd, how) == -1)
+            return ERR_DB_FILE;
+        if (fstat(fd, &fd_st) == -1 || stat(DB_FILE, &path_st) == -1)
+            return ERR_DB_FILE;
+        if (fd_st.st_dev == path_st.st_dev && fd_st.st_ino == path_st.st_ino)
+            return NO_ERROR;
+
+        // DB_FILE was replaced while we waited, move fd over to the new one
+        int new_fd = open_db(DB_FILE, false);
+        if (new_fd < 0)
+            return ERR_DB_FILE;
+        if (dup2(new_fd, fd) == -1)
+        {
+            close(new_fd);
+            return ERR_DB_FILE;
+        }
+        close(new_fd);
+    }
+}
+
+void db_unlock(int fd)
+{
+    flock(fd, LOCK_UN);
+}
+
+// copies [off, off + len) of src to the same offset in dst
+static int copy_range(int src, int dst, off_t off, off_t len)
+{
+    char buff[64 * 1024];
+
+    while (len > 0)
+    {
+        off_t in_off = off, out_off = off;
+        ssize_t n = copy_file_range(src, &in_off, dst, &out_off, len, 0);
+        if (n == -1 && (errno == ENOSYS || errno == EXDEV || errno == EINVAL))
+        {
+            // no in-kernel copy between these files, fall back to read/write
+            n = pread(src, buff, len < (off_t)sizeof(buff) ? len : (off_t)sizeof(buff), off);
+            if (n > 0 && pwrite(dst, buff, n, off) != n)
+                return -1;
+        }
+        if (n <= 0)
+            return -1;
+        off += n;
+        len -= n;
+    }
+    return 0;
+}
+
+// copies only the allocated extents of src, so holes stay holes in dst
+static int copy_sparse(int src, int dst)
+{
+    off_t end = lseek(src, 0, SEEK_END);
+    off_t data = 0;
+
+    if (end == -1)
+        return -1;
+    while (data < end)
+    {
+        data = lseek(src, data, SEEK_DATA);
+        if (data == -1)
+        {
+            if (errno == ENXIO) // no more data, only a hole up to end
+                break;
+            return copy_range(src, dst, 0, end); // no SEEK_DATA support
+        }
+        off_t hole = lseek(src, data, SEEK_HOLE);
+        if (hole == -1 || copy_range(src, dst, data, hole - data) != 0)
+            return -1;
+        data = hole;
+    }
+    return ftruncate(dst, end);
+}
+
+/*
+ *  db_snapshot
+ *      fd:  linux file descriptor of DB_FILE
+ *
+ *  Long scans such as print_db() read from a private point-in-time copy of
+ *  the database so they never see a mix of old and new records.  The copy
+ *  is an anonymous file in the database directory, created with O_TMPFILE
+ *  (or mkstemp() + unlink() if the filesystem lacks it), so it disappears
+ *  when closed.
+ *
+ *  Where the filesystem supports reflinks (btrfs, xfs, bcachefs) the copy
+ *  is an ioctl(FICLONE) that shares the data blocks, so LOCK_SH is held
+ *  only for a metadata operation and readers never block writers.  On
+ *  other filesystems the allocated extents are copied while LOCK_SH is
+ *  held, which blocks writers for the length of the copy but not for the
+ *  length of the scan.
+ *
+ *  returns:  <number>       fd of the snapshot, the caller closes it
+ *            ERR_DB_FILE    database file I/O issue
+ *
+ *  console:  M_ERR_DB_READ  if the snapshot could not be made
+ */
+int db_snapshot(int fd)
+{
+    int snap_fd = open(".", O_TMPFILE | O_RDWR, S_IRUSR | S_IWUSR);
+    if (snap_fd == -1)
+    {
+        char tmpl[] = ".snap_student.XXXXXX";
+        snap_fd = mkstemp(tmpl);
+        if (snap_fd != -1)
+            unlink(tmpl);
+    }
+    if (snap_fd == -1)
+    {
+        printf(M_ERR_DB_READ);
+        return ERR_DB_FILE;
+    }
+
+    if (db_lock(fd, LOCK_SH) != NO_ERROR)
+    {
+        printf(M_ERR_DB_READ);
+        close(snap_fd);
+        return ERR_DB_FILE;
+    }
+    int rc = ioctl(snap_fd, FICLONE, fd);
+    if (rc == -1)
+        rc = copy_sparse(fd, snap_fd);
+    db_unlock(fd);
+
+    if (rc == -1)
+    {
+        printf(M_ERR_DB_READ);
+        close(snap_fd);
+        return ERR_DB_FILE;
+    }
+    return snap_fd;
+}
+
 /*
  *  get_student
  *      fd:  linux file descriptor
@@ -61,6 +251,47 @@ int open_db(char *dbFile, bool should_truncate)
  *  console:  Does not produce any console I/O used by other functions
  */
 int get_student(int fd, int id, student_t *s) {
+    db_rec_t rec;
+    int rc = get_db_rec(fd, id, &rec);
+    if (rc == NO_ERROR) {
+        memset(s, 0, sizeof(*s)); // student_t only has room for short names
+        s->id = rec.id;
+        s->gpa = rec.gpa;
+        strncpy(s->fname, rec.fname, sizeof(s->fname) - 1);
+        strncpy(s->lname, rec.lname, sizeof(s->lname) - 1);
+    }
+    return rc;
+}
+
+/*
+ *  get_db_rec
+ *      fd:  linux file descriptor
+ *      id:  the student id we are looking for
+ *      *r:  receives the student, with names of any length the format
+ *           stores
+ *
+ *  returns:  same as get_student()
+ */
+int get_db_rec(int fd, int id, db_rec_t *r) {
+    return db_ops_for(fd)->get(fd, id, r);
+}
+
+// a fixed format record in the accessor layer's form
+static void student_to_db_rec(const student_t *s, db_rec_t *r) {
+    r->id = s->id;
+    r->gpa = s->gpa;
+    r->fname_len = strnlen(s->fname, sizeof(s->fname));
+    r->lname_len = strnlen(s->lname, sizeof(s->lname));
+    memcpy(r->fname, s->fname, r->fname_len);
+    r->fname[r->fname_len] = '\0';
+    memcpy(r->lname, s->lname, r->lname_len);
+    r->lname[r->lname_len] = '\0';
+}
+
+// fixed format: the record for id lives at (id - 1) * STUDENT_RECORD_SIZE
+static int fixed_get(int fd, int id, db_rec_t *r) {
+    student_t student = {0};
+    student_t *s = &student;
     int offset = (id - 1) * STUDENT_RECORD_SIZE; // Calculate the offset for the student record
     if (lseek(fd, offset, SEEK_SET) == -1) { // Move file pointer to the record's position
         printf(M_ERR_DB_READ); // Error if seeking fails
@@ -73,6 +304,7 @@ int get_student(int fd, int id, student_t *s) {
     if (s->id != id) { // Check if the record's ID matches the requested ID
         return SRCH_NOT_FOUND; // Return if not found
     }
+    student_to_db_rec(s, r);
     return NO_ERROR; // Student found successfully
 }
 
@@ -102,11 +334,28 @@ int get_student(int fd, int id, student_t *s) {
  * 
  */
 int add_student(int fd, int id, char *fname, char *lname, int gpa) {
-    student_t student = {0}; // Initialize an empty student record
-    if (get_student(fd, id, &student) == NO_ERROR) { // Check if the student already exists
+    if (db_lock(fd, LOCK_EX) != NO_ERROR) { // Hold off snapshots and compress while writing
+        printf(M_ERR_DB_WRITE);
+        return ERR_DB_FILE;
+    }
+    const db_ops_t *ops = db_ops_for(fd); // Accessor for the db format
+    db_rec_t rec; // Receives the existing record, if any
+    if (ops->get(fd, id, &rec) == NO_ERROR) { // Check if the student already exists
+        db_unlock(fd);
         printf(M_ERR_DB_ADD_DUP, id); // Error if student exists
         return ERR_DB_OP;
     }
+    int rc = ops->put(fd, id, fname, lname, gpa); // Write the new student record
+    db_unlock(fd);
+    if (rc != NO_ERROR) {
+        return rc;
+    }
+    printf(M_STD_ADDED, id); // Success message
+    return NO_ERROR; // Student added successfully
+}
+
+static int fixed_put(int fd, int id, char *fname, char *lname, int gpa) {
+    student_t student = {0}; // Initialize an empty student record
     student.id = id; // Assign the student ID
     strncpy(student.fname, fname, sizeof(student.fname) - 1); // Copy first name
     strncpy(student.lname, lname, sizeof(student.lname) - 1); // Copy last name
@@ -120,8 +369,7 @@ int add_student(int fd, int id, char *fname, char *lname, int gpa) {
         printf(M_ERR_DB_WRITE); // Error if writing fails
         return ERR_DB_FILE;
     }
-    printf(M_STD_ADDED, id); // Success message
-    return NO_ERROR; // Student added successfully
+    return NO_ERROR;
 }
 
 /*
@@ -147,11 +395,27 @@ int add_student(int fd, int id, char *fname, char *lname, int gpa) {
  *
  */
 int del_student(int fd, int id) {
-    student_t student = {0}; // Initialize an empty student record
-    if (get_student(fd, id, &student) != NO_ERROR) { // Check if the student exists
+    if (db_lock(fd, LOCK_EX) != NO_ERROR) { // Hold off snapshots and compress while writing
+        printf(M_ERR_DB_WRITE);
+        return ERR_DB_FILE;
+    }
+    const db_ops_t *ops = db_ops_for(fd); // Accessor for the db format
+    db_rec_t rec; // Receives the record to delete
+    if (ops->get(fd, id, &rec) != NO_ERROR) { // Check if the student exists
+        db_unlock(fd);
         printf(M_STD_NOT_FND_MSG, id); // Error if student does not exist
         return ERR_DB_OP;
     }
+    int rc = ops->del(fd, id); // Remove the record
+    db_unlock(fd);
+    if (rc != NO_ERROR) {
+        return rc;
+    }
+    printf(M_STD_DEL_MSG, id); // Success message
+    return NO_ERROR; // Student deleted successfully
+}
+
+static int fixed_del(int fd, int id) {
     int offset = (id - 1) * STUDENT_RECORD_SIZE; // Calculate the offset for the record
     if (lseek(fd, offset, SEEK_SET) == -1) { // Move file pointer to the record's position
         printf(M_ERR_DB_WRITE); // Error if seeking fails
@@ -161,8 +425,44 @@ int del_student(int fd, int id) {
         printf(M_ERR_DB_WRITE); // Error if writing fails
         return ERR_DB_FILE;
     }
-    printf(M_STD_DEL_MSG, id); // Success message
-    return NO_ERROR; // Student deleted successfully
+    return NO_ERROR;
+}
+
+// fixed format scan: every non-zero 64 byte record is a student
+static int fixed_scan(int fd, db_scan_fn fn, void *ctx) {
+    student_t student = {0}; // Initialize an empty student record
+    db_rec_t rec;
+    if (lseek(fd, 0, SEEK_SET) == -1) { // Move file pointer to the beginning of the database
+        printf(M_ERR_DB_READ); // Error if seeking fails
+        return ERR_DB_FILE;
+    }
+    while (read(fd, &student, STUDENT_RECORD_SIZE) == STUDENT_RECORD_SIZE) { // Read each record
+        if (memcmp(&student, &EMPTY_STUDENT_RECORD, STUDENT_RECORD_SIZE) != 0) { // Check if the record is valid
+            student_to_db_rec(&student, &rec);
+            if (fn(&rec, ctx) != 0) {
+                break;
+            }
+        }
+    }
+    return NO_ERROR;
+}
+
+// fixed format copy: valid records are written back to back
+static int fixed_copy(int src_fd, int dst_fd) {
+    student_t student = {0}; // Initialize an empty student record
+    if (lseek(src_fd, 0, SEEK_SET) == -1) { // Move file pointer to the beginning of the database
+        printf(M_ERR_DB_READ); // Error if seeking fails
+        return ERR_DB_FILE;
+    }
+    while (read(src_fd, &student, STUDENT_RECORD_SIZE) == STUDENT_RECORD_SIZE) { // Read each record
+        if (memcmp(&student, &EMPTY_STUDENT_RECORD, STUDENT_RECORD_SIZE) != 0) { // Check if the record is valid
+            if (write(dst_fd, &student, STUDENT_RECORD_SIZE) != STUDENT_RECORD_SIZE) { // Write valid records to the temporary file
+                printf(M_ERR_DB_WRITE); // Error if writing fails
+                return ERR_DB_FILE;
+            }
+        }
+    }
+    return NO_ERROR;
 }
 
 /*
@@ -189,17 +489,22 @@ int del_student(int fd, int id) {
  *            M_ERR_DB_WRITE   error writing to db file (adding student)
  *
  */
+static int count_record(db_rec_t *r, void *ctx) {
+    (void)r;
+    (*(int *)ctx)++; // Increment the counter
+    return 0;
+}
+
 int count_db_records(int fd) {
-    student_t student = {0}; // Initialize an empty student record
     int count = 0; // Counter for valid records
-    if (lseek(fd, 0, SEEK_SET) == -1) { // Move file pointer to the beginning of the database
-        printf(M_ERR_DB_READ); // Error if seeking fails
+    int snap_fd = db_snapshot(fd); // Count a consistent point-in-time copy
+    if (snap_fd < 0) {
         return ERR_DB_FILE;
     }
-    while (read(fd, &student, STUDENT_RECORD_SIZE) == STUDENT_RECORD_SIZE) { // Read each record
-        if (memcmp(&student, &EMPTY_STUDENT_RECORD, STUDENT_RECORD_SIZE) != 0) { // Check if the record is valid
-            count++; // Increment the counter
-        }
+    int rc = db_ops_for(snap_fd)->scan(snap_fd, count_record, &count); // Visit each valid record
+    close(snap_fd);
+    if (rc != NO_ERROR) {
+        return ERR_DB_FILE;
     }
     if (count == 0) { // Check if the database is empty
         printf(M_DB_EMPTY); // Message for an empty database
@@ -238,25 +543,33 @@ int count_db_records(int fd) {
  *            ERR_DB_FILE    database file I/O issue
  *
  *
+ *  Records are printed in the order the format stores them: id order for
+ *  the fixed format, the order they were added in for a slotted db.
+ *
  *  console:  <see above>      on success, print table or database empty
  *            M_ERR_DB_READ    error reading or seeking the database file
  *
  */
+static int print_record(db_rec_t *rec, void *ctx) {
+    bool *header_printed = ctx;
+    if (!*header_printed) { // Print the header if not already printed
+        printf(STUDENT_PRINT_HDR_STRING, "ID", "FIRST_NAME", "LAST_NAME", "GPA");
+        *header_printed = true; // Set the flag
+    }
+    printf(DB_REC_PRINT_FMT_STRING, rec->id, rec->fname, rec->lname, rec->gpa / 100.0); // Print the record, full names
+    return 0;
+}
+
 int print_db(int fd) {
-    student_t student = {0}; // Initialize an empty student record
     bool header_printed = false; // Flag to print the header once
-    if (lseek(fd, 0, SEEK_SET) == -1) { // Move file pointer to the beginning of the database
-        printf(M_ERR_DB_READ); // Error if seeking fails
+    int snap_fd = db_snapshot(fd); // Print a consistent point-in-time copy
+    if (snap_fd < 0) {
         return ERR_DB_FILE;
     }
-    while (read(fd, &student, STUDENT_RECORD_SIZE) == STUDENT_RECORD_SIZE) { // Read each record
-        if (memcmp(&student, &EMPTY_STUDENT_RECORD, STUDENT_RECORD_SIZE) != 0) { // Check if the record is valid
-            if (!header_printed) { // Print the header if not already printed
-                printf(STUDENT_PRINT_HDR_STRING, "ID", "FIRST_NAME", "LAST_NAME", "GPA");
-                header_printed = true; // Set the flag
-            }
-            printf(STUDENT_PRINT_FMT_STRING, student.id, student.fname, student.lname, student.gpa / 100.0); // Print the record
-        }
+    int rc = db_ops_for(snap_fd)->scan(snap_fd, print_record, &header_printed); // Visit each valid record
+    close(snap_fd);
+    if (rc != NO_ERROR) {
+        return ERR_DB_FILE;
     }
     if (!header_printed) { // Check if no valid records were found
         printf(M_DB_EMPTY); // Message for an empty database
@@ -301,6 +614,16 @@ void print_student(student_t *s) {
     printf(STUDENT_PRINT_FMT_STRING, s->id, s->fname, s->lname, s->gpa / 100.0); // Print the student record
 }
 
+// print_student() for a db_rec_t, the names are printed in full
+void print_db_rec(db_rec_t *r) {
+    if (r == NULL || r->id == 0) { // Validate the student record
+        printf(M_ERR_STD_PRINT); // Error if invalid
+        return;
+    }
+    printf(STUDENT_PRINT_HDR_STRING, "ID", "FIRST_NAME", "LAST_NAME", "GPA"); // Print the header
+    printf(DB_REC_PRINT_FMT_STRING, r->id, r->fname, r->lname, r->gpa / 100.0); // Print the student record
+}
+
 /*
  *  NOTE IMPLEMENTING THIS FUNCTION IS EXTRA CREDIT
  *
@@ -350,35 +673,122 @@ void print_student(student_t *s) {
  *
  */
 int compress_db(int fd) {
+    // Writers are held off until the rename is done, so a student added
+    // during the copy cannot be left behind in the old file
+    if (db_lock(fd, LOCK_EX) != NO_ERROR) {
+        printf(M_ERR_DB_READ);
+        return ERR_DB_FILE;
+    }
+    const db_ops_t *ops = db_ops_for(fd); // Compressed db keeps the same format
     int temp_fd = open(TMP_DB_FILE, O_RDWR | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP); // Create a temporary file
     if (temp_fd == -1) { // Check if the file creation failed
+        db_unlock(fd);
         printf(M_ERR_DB_OPEN); // Error if failed
         return ERR_DB_FILE;
     }
-    student_t student = {0}; // Initialize an empty student record
-    if (lseek(fd, 0, SEEK_SET) == -1) { // Move file pointer to the beginning of the database
-        printf(M_ERR_DB_READ); // Error if seeking fails
+    if (ops->copy(fd, temp_fd) != NO_ERROR) { // Copy the valid records to the temporary file
+        db_unlock(fd);
         close(temp_fd); // Close the temporary file
         return ERR_DB_FILE;
     }
-    while (read(fd, &student, STUDENT_RECORD_SIZE) == STUDENT_RECORD_SIZE) { // Read each record
-        if (memcmp(&student, &EMPTY_STUDENT_RECORD, STUDENT_RECORD_SIZE) != 0) { // Check if the record is valid
-            if (write(temp_fd, &student, STUDENT_RECORD_SIZE) != STUDENT_RECORD_SIZE) { // Write valid records to the temporary file
-                printf(M_ERR_DB_WRITE); // Error if writing fails
-                close(temp_fd); // Close the temporary file
-                return ERR_DB_FILE;
-            }
-        }
-    }
-    close(fd); // Close the original database file
+    close(temp_fd);
     if (rename(TMP_DB_FILE, DB_FILE) == -1) { // Rename the temporary file to the database file
+        db_unlock(fd);
         printf(M_ERR_DB_CREATE); // Error if renaming fails
         return ERR_DB_FILE;
     }
+    close(fd); // Close the original database file, this drops the lock
     printf(M_DB_COMPRESSED_OK); // Success message
     return open_db(DB_FILE, false); // Reopen the compressed database
 }
 
+// reports logical size and allocated blocks of a db file
+static void report_size(const char *name, int fd, struct stat *st) {
+    fstat(fd, st);
+    printf(M_DB_SIZE_RPT, name, (long)st->st_size, (long)st->st_blocks * 512);
+}
+
+// reports how long a full scan of the db takes, best of a few runs
+static void report_scan(int fd, const db_ops_t *ops) {
+    double best_ms = 0;
+    int count = 0;
+    for (int rep = 0; rep < 5; rep++) {
+        struct timespec t0, t1;
+        count = 0;
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        ops->scan(fd, count_record, &count);
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        double ms = (t1.tv_sec - t0.tv_sec) * 1e3 + (t1.tv_nsec - t0.tv_nsec) / 1e6;
+        if (rep == 0 || ms < best_ms) {
+            best_ms = ms;
+        }
+    }
+    printf(M_DB_SCAN_RPT, ops->name, count, best_ms,
+           best_ms > 0 ? count / best_ms / 1e3 : 0.0);
+}
+
+/*
+ *  migrate_db
+ *      fd:     linux file descriptor
+ *
+ *  Converts a fixed format database into the slotted page format described
+ *  in slotdb.h.  Like compress_db() the new db is built in TMP_DB_FILE and
+ *  then renamed over DB_FILE.  Before the rename the size of both files and
+ *  the time to scan them is reported so the two formats can be compared.
+ *
+ *  returns:  <number>       returns the fd of the converted database file
+ *            ERR_DB_FILE    database file I/O issue
+ *
+ *  console:  M_DB_SIZE_RPT, M_DB_SIZE_SAVED, M_DB_SCAN_RPT and
+ *            M_DB_MIGRATED_OK on success
+ *            M_DB_ALREADY_SLOT if the database is already slotted
+ *            same error messages as compress_db()
+ */
+int migrate_db(int fd) {
+    struct stat fixed_st, slot_st;
+    if (db_lock(fd, LOCK_EX) != NO_ERROR) { // Same rules as compress_db()
+        printf(M_ERR_DB_READ);
+        return ERR_DB_FILE;
+    }
+    const db_ops_t *ops = db_ops_for(fd);
+    if (ops == &SLOT_DB_OPS) {
+        db_unlock(fd);
+        printf(M_DB_ALREADY_SLOT);
+        return fd;
+    }
+    int temp_fd = open(TMP_DB_FILE, O_RDWR | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP); // Create a temporary file
+    if (temp_fd == -1) {
+        db_unlock(fd);
+        printf(M_ERR_DB_OPEN);
+        return ERR_DB_FILE;
+    }
+    if (slot_build(temp_fd, fd, ops) != NO_ERROR) {
+        db_unlock(fd);
+        close(temp_fd);
+        unlink(TMP_DB_FILE);
+        return ERR_DB_FILE;
+    }
+    fsync(temp_fd); // Make st_blocks reflect the written pages
+
+    report_size(FIXED_DB_OPS.name, fd, &fixed_st);
+    report_size(SLOT_DB_OPS.name, temp_fd, &slot_st);
+    printf(M_DB_SIZE_SAVED,
+           fixed_st.st_size ? 100.0 * (fixed_st.st_size - slot_st.st_size) / fixed_st.st_size : 0.0,
+           fixed_st.st_blocks ? 100.0 * (fixed_st.st_blocks - slot_st.st_blocks) / fixed_st.st_blocks : 0.0);
+    report_scan(fd, &FIXED_DB_OPS);
+    report_scan(temp_fd, &SLOT_DB_OPS);
+
+    close(temp_fd);
+    if (rename(TMP_DB_FILE, DB_FILE) == -1) {
+        db_unlock(fd);
+        printf(M_ERR_DB_CREATE);
+        return ERR_DB_FILE;
+    }
+    close(fd);
+    printf(M_DB_MIGRATED_OK);
+    return open_db(DB_FILE, false);
+}
+
 /*
  *  validate_range
  *      id:  proposed student id
@@ -419,13 +829,14 @@ int validate_range(int id, int gpa)
  */
 void usage(char *exename)
 {
-    printf("usage: %s -[h|a|c|d|f|p|z] options.  Where:\n", exename);
+    printf("usage: %s -[h|a|c|d|f|p|m|x|z] options.  Where:\n", exename);
     printf("\t-h:  prints help\n");
     printf("\t-a id first_name last_name gpa(as 3 digit int):  adds a student\n");
     printf("\t-c:  counts the records in the database\n");
     printf("\t-d id:  deletes a student\n");
     printf("\t-f id:  finds and prints a student in the database\n");
     printf("\t-p:  prints all records in the student database\n");
+    printf("\t-m:  convert the database to the slotted page format\n");
     printf("\t-x:  compress the database file [EXTRA CREDIT]\n");
     printf("\t-z:  zero db file (remove all records)\n");
 }
@@ -440,10 +851,9 @@ int main(int argc, char *argv[])
     int id;        // userid from argv[2]
     int gpa;       // gpa from argv[5]
 
-    // space for a student structure which we will get back from
-    // some of the functions we will be writing such as get_student(),
-    // and print_student().
-    student_t student = {0};
+    // space for a student record which we will get back from
+    // get_db_rec() and print with print_db_rec(), names in full
+    db_rec_t student = {0};
 
     // This function must have at least one arg, and the arg must start
     // with a dash
@@ -550,12 +960,12 @@ int main(int argc, char *argv[])
             break;
         }
         id = atoi(argv[2]);
-        rc = get_student(fd, id, &student);
+        rc = get_db_rec(fd, id, &student);
 
         switch (rc)
         {
         case NO_ERROR:
-            print_student(&student);
+            print_db_rec(&student);
             break;
         case SRCH_NOT_FOUND:
             printf(M_STD_NOT_FND_MSG, id);
@@ -591,6 +1001,18 @@ int main(int argc, char *argv[])
             exit_code = EXIT_FAIL_DB;
         break;
 
+    case 'm':
+        //    arv[0] arv[1]
+        // prog_name     -m
+        //-----------------
+        // example:  prog_name -m
+
+        // like compress_db, migrate_db returns the fd of the new database
+        fd = migrate_db(fd);
+        if (fd < 0)
+            exit_code = EXIT_FAIL_DB;
+        break;
+
     case 'z':
         //    arv[0] arv[1]
         // prog_name     -x
@@ -1,4 +1,7 @@
 #ifndef __SDB_H__
+    #define __SDB_H__
+
+#include <stdbool.h>
 
 #include "db.h" //get student record type
 
@@ -12,8 +15,52 @@ void print_student(student_t *s);
 int validate_range(int id, int gpa);
 int count_db_records(int fd);
 int print_db(int fd);
+int migrate_db(int fd);
+int db_lock(int fd, int how);
+void db_unlock(int fd);
+int db_snapshot(int fd);
 void usage(char *);
 
+//accessor layer: the record level operations for one on-disk format.  The
+//functions above look up the table for the open file with db_ops_for() so
+//they work the same on the fixed 64 byte format and on the slotted page
+//format from slotdb.h.
+//  get   - same contract as get_student(), into a full length db_rec_t
+//  put   - writes a new record, the caller has already checked for duplicates
+//  del   - removes a record, the caller has already checked that it exists
+//  scan  - calls fn for every live record, stops early if fn returns non-zero
+//  copy  - writes every live record of src_fd into the empty file dst_fd
+#define DB_NAME_MAX     255     //longest name the slotted format stores
+
+//a record as the accessor layer passes it around.  Unlike student_t the
+//names are not cut to the fixed format's field sizes, they are NUL
+//terminated and the lengths are kept for code that wants them.
+typedef struct db_rec{
+    int  id;
+    int  gpa;
+    int  fname_len;
+    int  lname_len;
+    char fname[DB_NAME_MAX + 1];
+    char lname[DB_NAME_MAX + 1];
+} db_rec_t;
+
+typedef int (*db_scan_fn)(db_rec_t *r, void *ctx);
+
+typedef struct db_ops{
+    const char *name;
+    int (*get)(int fd, int id, db_rec_t *r);
+    int (*put)(int fd, int id, char *fname, char *lname, int gpa);
+    int (*del)(int fd, int id);
+    int (*scan)(int fd, db_scan_fn fn, void *ctx);
+    int (*copy)(int src_fd, int dst_fd);
+} db_ops_t;
+
+extern const db_ops_t FIXED_DB_OPS;
+extern const db_ops_t SLOT_DB_OPS;
+const db_ops_t *db_ops_for(int fd);
+int get_db_rec(int fd, int id, db_rec_t *r);
+void print_db_rec(db_rec_t *r);
+
 //error codes to be returned from individual functions
 // NO_ERROR is returned if there are no errors
 // ERR_DB_FILE is returned if there is are any issues with the database file itself
@@ -53,6 +100,11 @@ void usage(char *);
 #define M_DB_EMPTY        "Database contains no student records.\n"
 #define M_DB_RECORD_CNT   "Database contains %d student record(s).\n"
 #define M_NOT_IMPL        "The requested operation is not implemented yet!\n"
+#define M_DB_MIGRATED_OK  "Database successfully converted to slotted page format!\n"
+#define M_DB_ALREADY_SLOT "Database is already in slotted page format.\n"
+#define M_DB_SIZE_RPT     "%-8s size: %10ld bytes, on disk: %10ld bytes\n"
+#define M_DB_SIZE_SAVED   "size reduction: %.1f%% logical, %.1f%% on disk\n"
+#define M_DB_SCAN_RPT     "%-8s scan: %d records in %.3f ms (%.2f M records/s)\n"
 
 //useful format strings for print students
 //For example to print the header in the required output:
@@ -60,5 +112,6 @@ void usage(char *);
 //                                   "LAST_NAME", "GPA");
 #define  STUDENT_PRINT_HDR_STRING   "%-6s %-24s %-32s %-3s\n"
 #define  STUDENT_PRINT_FMT_STRING   "%-6d %-24.24s %-32.32s %-3.2f\n"
+#define  DB_REC_PRINT_FMT_STRING    "%-6d %-24s %-32s %-3.2f\n"  //full names
 
 #endif
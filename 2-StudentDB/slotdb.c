@@ -0,0 +1,670 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <unistd.h>
+
+// Database include files
+#include "db.h"
+#include "sdbsc.h"
+#include "slotdb.h"
+
+// Full length view of one slotted record.  The names point into a page
+// buffer and are not NUL terminated, use the *_len fields.
+typedef struct slot_rec{
+    int id;
+    int gpa;
+    const char *fname;
+    int fname_len;
+    const char *lname;
+    int lname_len;
+} slot_rec_t;
+
+typedef int (*slot_rec_fn)(slot_rec_t *r, void *ctx);
+
+// In memory copy of the header page.  dict[] points at the [len][bytes]
+// dictionary entries stored in page[].
+typedef struct slot_meta{
+    slot_file_hdr_t hdr;
+    _Alignas(8) uint8_t page[SLOT_PAGE_SZ];
+    const uint8_t *dict[SLOT_DICT_MAX];
+} slot_meta_t;
+
+#define SLOT_DIR_START  ((int)sizeof(slot_page_hdr_t))
+#define SLOT_DICT_ROOM  (SLOT_PAGE_SZ - (int)sizeof(slot_file_hdr_t))
+#define SLOT_REC_MAX    (4 + 2 * (SLOT_NAME_MAX + 1))
+
+const db_ops_t SLOT_DB_OPS = {
+    "slotted", slot_get, slot_put, slot_del, slot_scan, slot_copy
+};
+
+/*
+ *  read_page / write_page
+ *      fd:     linux file descriptor
+ *      pgno:   page number, page 0 is the file header
+ *      page:   SLOT_PAGE_SZ bytes of storage
+ *
+ *  returns:  0 on success, -1 on a short read/write or I/O error
+ */
+static int read_page(int fd, uint32_t pgno, uint8_t *page) {
+    off_t offset = (off_t)pgno * SLOT_PAGE_SZ;
+    return pread(fd, page, SLOT_PAGE_SZ, offset) == SLOT_PAGE_SZ ? 0 : -1;
+}
+
+static int write_page(int fd, uint32_t pgno, const uint8_t *page) {
+    off_t offset = (off_t)pgno * SLOT_PAGE_SZ;
+    return pwrite(fd, page, SLOT_PAGE_SZ, offset) == SLOT_PAGE_SZ ? 0 : -1;
+}
+
+// index the dictionary entries that follow the file header
+static void index_dict(slot_meta_t *m) {
+    const uint8_t *p = m->page + sizeof(slot_file_hdr_t);
+    for (int i = 0; i < m->hdr.dict_count; i++) {
+        m->dict[i] = p;
+        p += 1 + p[0];
+    }
+}
+
+// read the header page into m, returns -1 if it is not a slotted db
+static int load_meta(int fd, slot_meta_t *m) {
+    if (read_page(fd, 0, m->page) != 0)
+        return -1;
+    memcpy(&m->hdr, m->page, sizeof(m->hdr));
+    if (memcmp(m->hdr.magic, SLOT_MAGIC, SLOT_MAGIC_LEN) != 0)
+        return -1;
+    index_dict(m);
+    return 0;
+}
+
+static int store_meta(int fd, slot_meta_t *m) {
+    memcpy(m->page, &m->hdr, sizeof(m->hdr));
+    return write_page(fd, 0, m->page);
+}
+
+// orders names the same way strcmp() would, without needing a terminator
+static int name_cmp(const char *a, int alen, const char *b, int blen) {
+    int n = alen < blen ? alen : blen;
+    int rc = memcmp(a, b, n);
+    if (rc != 0)
+        return rc;
+    return alen - blen;
+}
+
+// binary search of the sorted dictionary, returns the index or -1
+static int dict_find(slot_meta_t *m, const char *name, int len) {
+    int lo = 0;
+    int hi = m->hdr.dict_count - 1;
+    while (lo <= hi) {
+        int mid = (lo + hi) / 2;
+        const uint8_t *e = m->dict[mid];
+        int rc = name_cmp(name, len, (const char *)e + 1, e[0]);
+        if (rc == 0)
+            return mid;
+        if (rc < 0)
+            hi = mid - 1;
+        else
+            lo = mid + 1;
+    }
+    return -1;
+}
+
+static int clamp_name(int len) {
+    return len > SLOT_NAME_MAX ? SLOT_NAME_MAX : len;
+}
+
+// encodes a record into out (at least SLOT_REC_MAX bytes), returns its length
+static int rec_encode(slot_meta_t *m, uint8_t *out, int gpa,
+                      const char *fname, int flen, const char *lname, int llen) {
+    uint16_t g = (uint16_t)gpa;
+    int pos = 0;
+    flen = clamp_name(flen);
+    llen = clamp_name(llen);
+    int dict_idx = dict_find(m, lname, llen);
+
+    memcpy(out, &g, sizeof(g));
+    pos += sizeof(g);
+    out[pos++] = dict_idx >= 0 ? SLOT_REC_DICT : 0;
+    out[pos++] = (uint8_t)flen;
+    memcpy(out + pos, fname, flen);
+    pos += flen;
+    if (dict_idx >= 0) {
+        out[pos++] = (uint8_t)dict_idx;
+    } else {
+        out[pos++] = (uint8_t)llen;
+        memcpy(out + pos, lname, llen);
+        pos += llen;
+    }
+    return pos;
+}
+
+static void rec_decode(slot_meta_t *m, int id, const uint8_t *p, slot_rec_t *r) {
+    uint16_t g;
+    memcpy(&g, p, sizeof(g));
+    uint8_t flags = p[2];
+    r->id = id;
+    r->gpa = g;
+    r->fname_len = p[3];
+    r->fname = (const char *)p + 4;
+    p += 4 + r->fname_len;
+    if (flags & SLOT_REC_DICT)
+        p = m->dict[p[0]];
+    r->lname_len = p[0];
+    r->lname = (const char *)p + 1;
+}
+
+// copies a record out of its page, names keep their full length
+static void rec_to_db(slot_rec_t *r, db_rec_t *d) {
+    d->id = r->id;
+    d->gpa = r->gpa;
+    d->fname_len = r->fname_len;
+    d->lname_len = r->lname_len;
+    memcpy(d->fname, r->fname, r->fname_len);
+    d->fname[r->fname_len] = '\0';
+    memcpy(d->lname, r->lname, r->lname_len);
+    d->lname[r->lname_len] = '\0';
+}
+
+static slot_page_hdr_t *page_hdr(uint8_t *page) {
+    return (slot_page_hdr_t *)page;
+}
+
+static slot_entry_t *page_slots(uint8_t *page) {
+    return (slot_entry_t *)(page + SLOT_DIR_START);
+}
+
+static int page_free(uint8_t *page) {
+    slot_page_hdr_t *ph = page_hdr(page);
+    return ph->free_end - (SLOT_DIR_START + ph->nslots * (int)sizeof(slot_entry_t));
+}
+
+static void page_init(uint8_t *page) {
+    memset(page, 0, SLOT_PAGE_SZ);
+    page_hdr(page)->free_end = SLOT_PAGE_SZ;
+}
+
+// appends a record to page, the caller has checked that it fits
+static void page_append(uint8_t *page, int id, const uint8_t *rec, int len) {
+    slot_page_hdr_t *ph = page_hdr(page);
+    slot_entry_t *se = &page_slots(page)[ph->nslots++];
+    ph->free_end -= len;
+    memcpy(page + ph->free_end, rec, len);
+    se->id = id;
+    se->off = ph->free_end;
+    se->len = len;
+}
+
+/*
+ *  slot_is_slotted
+ *      fd:  linux file descriptor
+ *
+ *  returns:  1 if the file starts with the slotted page magic, 0 otherwise
+ *            (including empty and fixed format files)
+ */
+int slot_is_slotted(int fd) {
+    char magic[SLOT_MAGIC_LEN];
+    if (pread(fd, magic, sizeof(magic), 0) != (ssize_t)sizeof(magic))
+        return 0;
+    return memcmp(magic, SLOT_MAGIC, SLOT_MAGIC_LEN) == 0;
+}
+
+/*
+ *  slot_walk
+ *      fd:   linux file descriptor of a slotted db
+ *      fn:   called with the full length view of every live record
+ *      ctx:  passed through to fn
+ *
+ *  Reads the db one page at a time, so a scan touches only the bytes that
+ *  hold live data.  Stops early if fn returns non-zero.
+ *
+ *  returns:  NO_ERROR on success, ERR_DB_FILE on an I/O issue
+ */
+static int slot_walk(int fd, slot_rec_fn fn, void *ctx) {
+    slot_meta_t meta;
+    _Alignas(8) uint8_t page[SLOT_PAGE_SZ];
+    slot_rec_t rec;
+
+    if (load_meta(fd, &meta) != 0)
+        return ERR_DB_FILE;
+    for (uint32_t pg = 1; pg <= meta.hdr.page_count; pg++) {
+        if (read_page(fd, pg, page) != 0)
+            return ERR_DB_FILE;
+        slot_entry_t *slots = page_slots(page);
+        for (int i = 0; i < page_hdr(page)->nslots; i++) {
+            if (slots[i].id == DELETED_STUDENT_ID)
+                continue;
+            rec_decode(&meta, slots[i].id, page + slots[i].off, &rec);
+            if (fn(&rec, ctx) != 0)
+                return NO_ERROR;
+        }
+    }
+    return NO_ERROR;
+}
+
+/*
+ *  slot_find
+ *      fd:     linux file descriptor of a slotted db
+ *      m:      header page loaded with load_meta()
+ *      id:     student id to look for
+ *      page:   receives the page holding the record
+ *      pgno:   receives the page number
+ *      slot:   receives the index in the slot directory
+ *
+ *  Only the slot directories are examined, records are not decoded, but
+ *  there is no index: every page up to the one holding id is read.
+ *
+ *  returns:  1 found, 0 not found, -1 on an I/O issue
+ */
+static int slot_find(int fd, slot_meta_t *m, int id, uint8_t *page,
+                     uint32_t *pgno, int *slot) {
+    for (uint32_t pg = 1; pg <= m->hdr.page_count; pg++) {
+        if (read_page(fd, pg, page) != 0)
+            return -1;
+        slot_entry_t *slots = page_slots(page);
+        for (int i = 0; i < page_hdr(page)->nslots; i++) {
+            if (slots[i].id == id) {
+                *pgno = pg;
+                *slot = i;
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+/*
+ *  slot_get
+ *      fd:  linux file descriptor
+ *      id:  the student id we are looking for
+ *      *r:  receives the student with its full length names
+ *
+ *  returns:  same as get_student()
+ *
+ *  console:  M_ERR_DB_READ on an I/O issue
+ */
+int slot_get(int fd, int id, db_rec_t *r) {
+    slot_meta_t meta;
+    _Alignas(8) uint8_t page[SLOT_PAGE_SZ];
+    uint32_t pgno;
+    int slot;
+    slot_rec_t rec;
+
+    if (id == DELETED_STUDENT_ID)
+        return SRCH_NOT_FOUND;
+    if (load_meta(fd, &meta) != 0) {
+        printf(M_ERR_DB_READ);
+        return ERR_DB_FILE;
+    }
+    int rc = slot_find(fd, &meta, id, page, &pgno, &slot);
+    if (rc < 0) {
+        printf(M_ERR_DB_READ);
+        return ERR_DB_FILE;
+    }
+    if (rc == 0)
+        return SRCH_NOT_FOUND;
+    slot_entry_t *se = &page_slots(page)[slot];
+    rec_decode(&meta, se->id, page + se->off, &rec);
+    rec_to_db(&rec, r);
+    return NO_ERROR;
+}
+
+/*
+ *  slot_put
+ *      fd:     linux file descriptor
+ *      id:     student id, the caller has checked it is not a duplicate
+ *      fname:  first name, stored up to SLOT_NAME_MAX bytes
+ *      lname:  last name, stored as a dictionary index if it is in the
+ *              dictionary built by slot_build()
+ *      gpa:    GPA as an integer
+ *
+ *  Reuses the space of a deleted record if one is big enough, otherwise
+ *  puts the record in the first page with room, otherwise adds a page.
+ *
+ *  returns:  NO_ERROR on success, ERR_DB_FILE on an I/O issue
+ *
+ *  console:  M_ERR_DB_WRITE on an I/O issue
+ */
+int slot_put(int fd, int id, char *fname, char *lname, int gpa) {
+    slot_meta_t meta;
+    _Alignas(8) uint8_t page[SLOT_PAGE_SZ];
+    uint8_t rec[SLOT_REC_MAX];
+
+    if (load_meta(fd, &meta) != 0) {
+        printf(M_ERR_DB_WRITE);
+        return ERR_DB_FILE;
+    }
+    int len = rec_encode(&meta, rec, gpa, fname, strlen(fname), lname, strlen(lname));
+
+    for (uint32_t pg = 1; pg <= meta.hdr.page_count; pg++) {
+        if (read_page(fd, pg, page) != 0) {
+            printf(M_ERR_DB_WRITE);
+            return ERR_DB_FILE;
+        }
+        slot_entry_t *slots = page_slots(page);
+        for (int i = 0; i < page_hdr(page)->nslots; i++) {
+            if (slots[i].id == DELETED_STUDENT_ID && slots[i].len >= len) {
+                memcpy(page + slots[i].off, rec, len);
+                slots[i].id = id;
+                slots[i].len = len;
+                if (write_page(fd, pg, page) != 0) {
+                    printf(M_ERR_DB_WRITE);
+                    return ERR_DB_FILE;
+                }
+                return NO_ERROR;
+            }
+        }
+        if (page_free(page) >= len + (int)sizeof(slot_entry_t)) {
+            page_append(page, id, rec, len);
+            if (write_page(fd, pg, page) != 0) {
+                printf(M_ERR_DB_WRITE);
+                return ERR_DB_FILE;
+            }
+            return NO_ERROR;
+        }
+    }
+
+    // no room anywhere, add a page at the end of the file
+    page_init(page);
+    page_append(page, id, rec, len);
+    meta.hdr.page_count++;
+    if (write_page(fd, meta.hdr.page_count, page) != 0 || store_meta(fd, &meta) != 0) {
+        printf(M_ERR_DB_WRITE);
+        return ERR_DB_FILE;
+    }
+    return NO_ERROR;
+}
+
+/*
+ *  slot_del
+ *      fd:  linux file descriptor
+ *      id:  student id to delete
+ *
+ *  Marks the slot as deleted.  The record bytes stay in the page until they
+ *  are reused by slot_put() or dropped by compress_db().
+ *
+ *  returns:  NO_ERROR, SRCH_NOT_FOUND, or ERR_DB_FILE on an I/O issue
+ *
+ *  console:  M_ERR_DB_WRITE on an I/O issue
+ */
+int slot_del(int fd, int id) {
+    slot_meta_t meta;
+    _Alignas(8) uint8_t page[SLOT_PAGE_SZ];
+    uint32_t pgno;
+    int slot;
+
+    if (load_meta(fd, &meta) != 0) {
+        printf(M_ERR_DB_WRITE);
+        return ERR_DB_FILE;
+    }
+    int rc = slot_find(fd, &meta, id, page, &pgno, &slot);
+    if (rc == 0)
+        return SRCH_NOT_FOUND;
+    if (rc < 0) {
+        printf(M_ERR_DB_WRITE);
+        return ERR_DB_FILE;
+    }
+    page_slots(page)[slot].id = DELETED_STUDENT_ID;
+    if (write_page(fd, pgno, page) != 0) {
+        printf(M_ERR_DB_WRITE);
+        return ERR_DB_FILE;
+    }
+    return NO_ERROR;
+}
+
+typedef struct scan_adapter{
+    db_scan_fn fn;
+    void *ctx;
+} scan_adapter_t;
+
+static int scan_to_db(slot_rec_t *r, void *ctx) {
+    scan_adapter_t *a = ctx;
+    db_rec_t d;
+    rec_to_db(r, &d);
+    return a->fn(&d, a->ctx);
+}
+
+/*
+ *  slot_scan
+ *      fd:   linux file descriptor
+ *      fn:   called with every live record in storage order, which is
+ *            the order they were added in, not id order
+ *      ctx:  passed through to fn
+ *
+ *  returns:  NO_ERROR on success, ERR_DB_FILE on an I/O issue
+ *
+ *  console:  M_ERR_DB_READ on an I/O issue
+ */
+int slot_scan(int fd, db_scan_fn fn, void *ctx) {
+    scan_adapter_t a = { fn, ctx };
+    if (slot_walk(fd, scan_to_db, &a) != NO_ERROR) {
+        printf(M_ERR_DB_READ);
+        return ERR_DB_FILE;
+    }
+    return NO_ERROR;
+}
+
+/*
+ *  slot_copy
+ *      src_fd:  slotted db to copy from
+ *      dst_fd:  empty file to copy into
+ *
+ *  Used by compress_db(), rewrites the live records into full pages and
+ *  rebuilds the last name dictionary.
+ */
+int slot_copy(int src_fd, int dst_fd) {
+    return slot_build(dst_fd, src_fd, &SLOT_DB_OPS);
+}
+
+/*************************  slotted db builder  *******************************/
+
+// one distinct last name seen while building the dictionary
+typedef struct name_count{
+    char *name;
+    int len;
+    int count;
+} name_count_t;
+
+typedef struct slot_builder{
+    int fd;
+    slot_meta_t *meta;
+    _Alignas(8) uint8_t page[SLOT_PAGE_SZ];
+    uint32_t pgno;          //page being filled, 0 before the first record
+    bool failed;
+    char **names;           //pass 1: every last name
+    int n_names;
+    int cap_names;
+} slot_builder_t;
+
+static int collect_name(slot_rec_t *r, void *ctx) {
+    slot_builder_t *b = ctx;
+    if (b->n_names == b->cap_names) {
+        int cap = b->cap_names ? b->cap_names * 2 : 256;
+        char **names = realloc(b->names, cap * sizeof(char *));
+        if (!names) {
+            b->failed = true;
+            return 1;
+        }
+        b->names = names;
+        b->cap_names = cap;
+    }
+    b->names[b->n_names] = strndup(r->lname, clamp_name(r->lname_len));
+    if (!b->names[b->n_names]) {
+        b->failed = true;
+        return 1;
+    }
+    b->n_names++;
+    return 0;
+}
+
+static int strptr_cmp(const void *a, const void *b) {
+    return strcmp(*(char * const *)a, *(char * const *)b);
+}
+
+// most bytes saved first
+static int savings_cmp(const void *a, const void *b) {
+    const name_count_t *x = a;
+    const name_count_t *y = b;
+    long sx = (long)x->count * x->len - (x->len + 1);
+    long sy = (long)y->count * y->len - (y->len + 1);
+    return (sx < sy) - (sx > sy);
+}
+
+static int name_count_cmp(const void *a, const void *b) {
+    return strcmp(((const name_count_t *)a)->name, ((const name_count_t *)b)->name);
+}
+
+/*
+ *  build_dict
+ *
+ *  Picks the last names that save the most bytes when replaced by a one
+ *  byte index, i.e. the ones that repeat, and stores them sorted in the
+ *  header page so dict_find() can binary search them.
+ */
+static void build_dict(slot_builder_t *b) {
+    slot_meta_t *m = b->meta;
+    name_count_t *runs;
+    int n_runs = 0;
+
+    m->hdr.dict_count = 0;
+    m->hdr.dict_bytes = 0;
+    if (b->n_names == 0)
+        return;
+    qsort(b->names, b->n_names, sizeof(char *), strptr_cmp);
+    runs = malloc(b->n_names * sizeof(name_count_t));
+    if (!runs)
+        return;     //no dictionary is still a valid db
+    for (int i = 0; i < b->n_names; i++) {
+        if (n_runs > 0 && strcmp(runs[n_runs - 1].name, b->names[i]) == 0) {
+            runs[n_runs - 1].count++;
+            continue;
+        }
+        runs[n_runs].name = b->names[i];
+        runs[n_runs].len = strlen(b->names[i]);
+        runs[n_runs].count = 1;
+        n_runs++;
+    }
+    qsort(runs, n_runs, sizeof(name_count_t), savings_cmp);
+
+    int chosen = 0;
+    int bytes = 0;
+    for (int i = 0; i < n_runs && chosen < SLOT_DICT_MAX; i++) {
+        long saved = (long)runs[i].count * runs[i].len - (runs[i].len + 1);
+        if (runs[i].count < 2 || saved <= 0)
+            break;
+        if (bytes + 1 + runs[i].len > SLOT_DICT_ROOM)
+            continue;
+        bytes += 1 + runs[i].len;
+        runs[chosen++] = runs[i];
+    }
+    qsort(runs, chosen, sizeof(name_count_t), name_count_cmp);
+
+    uint8_t *p = m->page + sizeof(slot_file_hdr_t);
+    for (int i = 0; i < chosen; i++) {
+        *p++ = (uint8_t)runs[i].len;
+        memcpy(p, runs[i].name, runs[i].len);
+        p += runs[i].len;
+    }
+    m->hdr.dict_count = chosen;
+    m->hdr.dict_bytes = bytes;
+    index_dict(m);
+    free(runs);
+}
+
+static void builder_flush(slot_builder_t *b) {
+    if (b->pgno > 0 && write_page(b->fd, b->pgno, b->page) != 0)
+        b->failed = true;
+}
+
+static int builder_add(slot_rec_t *r, void *ctx) {
+    slot_builder_t *b = ctx;
+    uint8_t rec[SLOT_REC_MAX];
+    int len = rec_encode(b->meta, rec, r->gpa, r->fname, r->fname_len,
+                         r->lname, r->lname_len);
+
+    if (b->pgno == 0 || page_free(b->page) < len + (int)sizeof(slot_entry_t)) {
+        builder_flush(b);
+        b->pgno++;
+        page_init(b->page);
+    }
+    page_append(b->page, r->id, rec, len);
+    return b->failed ? 1 : 0;
+}
+
+typedef struct fixed_adapter{
+    slot_rec_fn fn;
+    void *ctx;
+} fixed_adapter_t;
+
+static int db_to_rec(db_rec_t *d, void *ctx) {
+    fixed_adapter_t *a = ctx;
+    slot_rec_t r = {
+        d->id, d->gpa, d->fname, d->fname_len, d->lname, d->lname_len
+    };
+    return a->fn(&r, a->ctx);
+}
+
+// runs fn over every record of src, in full length form for slotted sources
+static int source_walk(int src_fd, const db_ops_t *src_ops, slot_rec_fn fn, void *ctx) {
+    if (src_ops == &SLOT_DB_OPS) {
+        if (slot_walk(src_fd, fn, ctx) != NO_ERROR) {
+            printf(M_ERR_DB_READ);
+            return ERR_DB_FILE;
+        }
+        return NO_ERROR;
+    }
+    fixed_adapter_t a = { fn, ctx };
+    return src_ops->scan(src_fd, db_to_rec, &a);
+}
+
+/*
+ *  slot_build
+ *      dst_fd:   empty file that receives the slotted db
+ *      src_fd:   db to read the records from
+ *      src_ops:  accessor for the src db format
+ *
+ *  Two passes over src: the first collects last names to build the
+ *  dictionary, the second packs the records into pages in source order.
+ *
+ *  returns:  NO_ERROR on success, ERR_DB_FILE on an I/O or memory issue
+ *
+ *  console:  M_ERR_DB_READ   error reading the source db
+ *            M_ERR_DB_WRITE  error writing the slotted db, or out of memory
+ */
+int slot_build(int dst_fd, int src_fd, const db_ops_t *src_ops) {
+    slot_meta_t meta;
+    slot_builder_t *b = calloc(1, sizeof(slot_builder_t));
+    int rc = NO_ERROR;
+
+    if (!b) {
+        printf(M_ERR_DB_WRITE);
+        return ERR_DB_FILE;
+    }
+    memset(&meta, 0, sizeof(meta));
+    memcpy(meta.hdr.magic, SLOT_MAGIC, SLOT_MAGIC_LEN);
+    b->fd = dst_fd;
+    b->meta = &meta;
+
+    if (source_walk(src_fd, src_ops, collect_name, b) != NO_ERROR) {
+        rc = ERR_DB_FILE;
+        goto done;
+    }
+    if (!b->failed)
+        build_dict(b);
+    if (!b->failed && source_walk(src_fd, src_ops, builder_add, b) != NO_ERROR) {
+        rc = ERR_DB_FILE;
+        goto done;
+    }
+    builder_flush(b);
+    meta.hdr.page_count = b->pgno;
+    if (b->failed || store_meta(dst_fd, &meta) != 0) {
+        printf(M_ERR_DB_WRITE);
+        rc = ERR_DB_FILE;
+    }
+
+done:
+    for (int i = 0; i < b->n_names; i++)
+        free(b->names[i]);
+    free(b->names);
+    free(b);
+    return rc;
+}
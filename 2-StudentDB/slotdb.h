@@ -0,0 +1,61 @@
+#ifndef __SLOTDB_H__
+    #define __SLOTDB_H__
+
+#include <stdint.h>
+
+#include "db.h"
+#include "sdbsc.h" //accessor layer types (db_ops_t, db_scan_fn)
+
+// Slotted page database format.  The fixed format pads every record out to
+// 64 bytes, so most of a record is zeros and names longer than the struct
+// fields get truncated.  The slotted format instead stores:
+//
+//   page 0:     slot_file_hdr_t followed by the last name dictionary, which
+//               is a packed list of [len][bytes] entries sorted by name
+//   page 1..n:  slot_page_hdr_t, then the slot directory growing up from the
+//               front of the page, and the record bytes growing down from
+//               the end of the page
+//
+// Each record is:
+//
+//   [gpa:2][flags:1][fname_len:1][fname bytes]
+//   then either [dict index:1]           if flags has SLOT_REC_DICT
+//   or          [lname_len:1][lname bytes]
+//
+// A deleted record keeps its slot entry with id == DELETED_STUDENT_ID so the
+// space can be reused by a later add of the same or smaller size.
+#define SLOT_MAGIC          "SDBSLOT1"
+#define SLOT_MAGIC_LEN      8
+#define SLOT_PAGE_SZ        4096
+#define SLOT_NAME_MAX       DB_NAME_MAX //names are length prefixed with one byte
+#define SLOT_DICT_MAX       255     //dictionary index is one byte
+#define SLOT_REC_DICT       0x01    //last name is a dictionary index
+
+typedef struct slot_file_hdr{
+    char     magic[SLOT_MAGIC_LEN];
+    uint32_t page_count;    //number of data pages after the header page
+    uint16_t dict_count;    //number of last name dictionary entries
+    uint16_t dict_bytes;    //bytes used by the dictionary after this header
+} slot_file_hdr_t;
+
+typedef struct slot_page_hdr{
+    uint16_t nslots;        //number of entries in the slot directory
+    uint16_t free_end;      //offset where the record heap currently starts
+} slot_page_hdr_t;
+
+typedef struct slot_entry{
+    int32_t  id;            //student id, DELETED_STUDENT_ID if deleted
+    uint16_t off;           //offset of the record inside the page
+    uint16_t len;           //length of the record in bytes
+} slot_entry_t;
+
+//prototypes for the slotted page backend, see slotdb.c
+int slot_is_slotted(int fd);
+int slot_get(int fd, int id, db_rec_t *r);
+int slot_put(int fd, int id, char *fname, char *lname, int gpa);
+int slot_del(int fd, int id);
+int slot_scan(int fd, db_scan_fn fn, void *ctx);
+int slot_copy(int src_fd, int dst_fd);
+int slot_build(int dst_fd, int src_fd, const db_ops_t *src_ops);
+
+#endif
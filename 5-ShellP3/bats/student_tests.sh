@@ -56,6 +56,38 @@ EOF
   [ "$status" -eq 0 ]
 }
 
+@test "Built-in: hash remembers command paths and hash -r forgets them" {
+  run ./dsh <<EOF
+ls -d /
+ls -d /
+hash
+hash -r
+hash
+exit
+EOF
+  [[ "$output" == *"   2	"*"/ls"* ]]
+  [[ "$output" == *"hash: hash table empty"* ]]
+  [ "$status" -eq 0 ]
+}
+
+@test "Built-in: a cached path that is gone is looked up again" {
+  mkdir -p test_bin1 test_bin2
+  cp /bin/echo test_bin1/hecho
+  cp /bin/echo test_bin2/hecho
+  PATH="$PWD/test_bin1:$PWD/test_bin2:$PATH" run ./dsh <<EOF
+hecho one
+rm test_bin1/hecho
+hecho two
+hash
+exit
+EOF
+  rm -rf test_bin1 test_bin2
+  [[ "$output" == *"two"* ]]
+  [[ "$output" == *"test_bin2/hecho"* ]]
+  [[ "$output" != *"test_bin1/hecho"* ]]
+  [ "$status" -eq 0 ]
+}
+
 # ------------------------------------------------------------------------------
 # quoting and spacing
 # ------------------------------------------------------------------------------
@@ -78,6 +110,33 @@ EOF
   [ "$status" -eq 0 ]
 }
 
+@test "Lexer: quoted operators are text, unquoted ones need no spaces" {
+  run ./dsh <<EOF
+echo "a|b > c"|tr a-z A-Z>test_out.txt
+cat test_out.txt
+exit
+EOF
+  [[ "$output" == *"A|B > C"* ]]
+  [ "$status" -eq 0 ]
+  rm -f test_out.txt
+}
+
+@test "Lexer: an empty pipeline stage is an error" {
+  run ./dsh <<EOF
+echo a || echo b
+| echo lead
+echo trail |
+echo ok
+exit
+EOF
+  [[ "$output" != *"b"$'\n'* ]]
+  [[ "$output" != *"lead"$'\n'* ]]
+  [[ "$output" != *"trail"$'\n'* ]]
+  [ "$(grep -c "error building command list" <<< "$output")" -eq 3 ]
+  [[ "$output" == *"ok"* ]]
+  [ "$status" -eq 0 ]
+}
+
 # ------------------------------------------------------------------------------
 # pipeline tests
 # ------------------------------------------------------------------------------
@@ -92,6 +151,67 @@ EOF
   [ "$status" -eq 0 ]
 }
 
+@test "Pipeline: more than eight commands" {
+  run ./dsh <<EOF
+echo deep | cat | cat | cat | cat | cat | cat | cat | cat | cat | cat | tr a-z A-Z
+exit
+EOF
+  [[ "$output" == *"DEEP"* ]]
+  [ "$status" -eq 0 ]
+}
+
+@test "Limits: lines longer than 320 characters with many arguments" {
+  args=$(seq -s ' ' 1 500)
+  run ./dsh <<EOF
+echo $args | wc -w
+exit
+EOF
+  [[ "$output" == *"500"* ]]
+  [ "$status" -eq 0 ]
+}
+
+@test "Pipeline: \$? is the last stage's status, pipefail and failfast change it" {
+  start=$SECONDS
+  run ./dsh <<EOF
+sh -c "exit 3" | cat
+echo "plain=\$?"
+set -o pipefail
+sh -c "exit 3" | cat
+echo "pipefail=\$?"
+set -o failfast
+sh -c "exit 2" | sleep 5
+echo "failfast=\$?"
+exit
+EOF
+  [[ "$output" == *"plain=0"* ]]
+  [[ "$output" == *"pipefail=3"* ]]
+  [[ "$output" == *"failfast=2"* ]]
+  [ $((SECONDS - start)) -lt 4 ]
+  [ "$status" -eq 0 ]
+}
+
+@test "Pipeline: set pipesize and a cat at either end give the same output" {
+  seq 1 5000 > test_pipe_in.txt
+  run ./dsh <<EOF
+set pipesize 1M
+set pipesize
+cat test_pipe_in.txt | wc -l
+cat < test_pipe_in.txt | tail -n 1
+cat . | wc -c
+seq 3 | cat > test_pipe_out.txt
+seq 3 | cat >> test_pipe_out.txt
+set pipesize 12x
+exit
+EOF
+  [[ "$output" == *"1048576"* ]]
+  [[ "$output" == *"5000"*"5000"* ]]
+  [[ "$output" == *"12x: invalid pipe size"* ]]
+  [[ "$output" == *"cat: .: Is a directory"* ]]
+  [ "$(cat test_pipe_out.txt | tr -d '\n')" = "123123" ]
+  [ "$status" -eq 0 ]
+  rm -f test_pipe_in.txt test_pipe_out.txt
+}
+
 # ------------------------------------------------------------------------------
 # redirection tests
 # ------------------------------------------------------------------------------
@@ -130,6 +250,92 @@ EOF
   rm in.txt
 }
 
+@test "Redirection: output file in the last stage of a pipeline" {
+  run ./dsh <<EOF
+echo "piped line" | tr a-z A-Z > test_out.txt
+cat test_out.txt
+exit
+EOF
+  [[ "$output" == *"PIPED LINE"* ]]
+  [ "$status" -eq 0 ]
+  rm -f test_out.txt
+}
+
+# ------------------------------------------------------------------------------
+# process launch tests
+# ------------------------------------------------------------------------------
+
+@test "Launch: fork fallback runs pipelines and redirects" {
+  DSH_LAUNCH=fork run ./dsh <<EOF
+echo "forked line" | tr a-z A-Z > test_out.txt
+cat < test_out.txt
+exit
+EOF
+  [[ "$output" == *"FORKED LINE"* ]]
+  [ "$status" -eq 0 ]
+  rm -f test_out.txt
+}
+
+# ------------------------------------------------------------------------------
+# script mode tests
+# ------------------------------------------------------------------------------
+
+@test "Script: dsh -f runs a file with no prompts and numbers its errors" {
+  cat > test_script.dsh <<EOF
+# comment line
+
+echo first
+not_a_real_command
+echo second
+EOF
+  run ./dsh -f test_script.dsh
+  [[ "$output" != *"dsh3>"* ]]
+  [[ "$output" == *"first"*"second"* ]]
+  [[ "$output" == *"test_script.dsh: line 4: "* ]]
+  [ "$status" -eq 0 ]
+  rm -f test_script.dsh
+}
+
+# ------------------------------------------------------------------------------
+# background job and parallel tests
+# ------------------------------------------------------------------------------
+
+@test "Jobs: & runs in the background, jobs lists it, wait and fg collect it" {
+  run ./dsh <<EOF
+sleep 1 &
+echo "foreground line"
+jobs
+wait
+sh -c "echo from the job" | tr a-z A-Z &
+fg
+jobs
+exit
+EOF
+  [[ "$output" == *"[1] "* ]]
+  [[ "$output" == *"foreground line"* ]]
+  [[ "$output" == *"[1]+  Running                 sleep 1 &"* ]]
+  [[ "$output" == *"FROM THE JOB"* ]]
+  [ "$status" -eq 0 ]
+}
+
+@test "Parallel: runs jobs at once and prints their output in argument order" {
+  printf 'a\nb\n' > test_args.txt
+  run ./dsh <<EOF
+parallel -j 3 sh -c "sleep 0.{}; echo job {}" ::: 3 1 2
+parallel echo from-{} < test_args.txt
+parallel -j
+parallel -j 0 echo ::: x
+parallel -j 1000000000 echo big-{} ::: 1 2
+exit
+EOF
+  [[ "$output" == *"job 3"*"job 1"*"job 2"* ]]
+  [[ "$output" == *"from-a"*"from-b"* ]]
+  [ "$(grep -c "usage: parallel" <<< "$output")" -eq 2 ]
+  [[ "$output" == *"big-1"*"big-2"* ]]
+  [ "$status" -eq 0 ]
+  rm -f test_args.txt
+}
+
 # ------------------------------------------------------------------------------
 # exit command test
 # ------------------------------------------------------------------------------
@@ -141,4 +347,4 @@ EOF
   [[ "$output" == *"exiting..."* ]]
   [[ "$output" == *"cmd loop returned 0"* ]]
   [ "$status" -eq 0 ]
-}
\ No newline at end of file
+}
@@ -0,0 +1,48 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* alloc_count
+ * LD_PRELOAD shim that counts the heap calls a process makes and prints
+ * the totals to stderr when it exits.  Calls are passed on to the glibc
+ * allocator through its __libc_* entry points, so no dlsym is needed.
+ *
+ *   LD_PRELOAD=./bench/alloc_count.so ./dsh < script
+ */
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t n, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void  __libc_free(void *ptr);
+
+static unsigned long n_malloc, n_calloc, n_realloc, n_free;
+
+void *malloc(size_t size) {
+    n_malloc++;
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t n, size_t size) {
+    n_calloc++;
+    return __libc_calloc(n, size);
+}
+
+void *realloc(void *ptr, size_t size) {
+    n_realloc++;
+    return __libc_realloc(ptr, size);
+}
+
+void free(void *ptr) {
+    if (ptr)
+        n_free++;
+    __libc_free(ptr);
+}
+
+__attribute__((destructor))
+static void alloc_count_report(void) {
+    char line[160];
+    int len = snprintf(line, sizeof(line),
+                       "alloc_count: malloc %lu calloc %lu realloc %lu free %lu\n",
+                       n_malloc, n_calloc, n_realloc, n_free);
+    write(STDERR_FILENO, line, len);
+}
@@ -0,0 +1,22 @@
+#!/usr/bin/env bash
+# Counts the heap calls dsh makes running a generated script of LINES
+# commands (default 100000).  The commands are builtins, so no child is
+# forked and the totals are the shell's own parsing and bookkeeping.
+#
+#   usage: bench/alloc_count.sh [lines]
+set -e
+cd "$(dirname "$0")/.."
+lines=${1:-100000}
+script=$(mktemp)
+trap 'rm -f "$script"' EXIT
+
+gcc -O2 -shared -fPIC -o bench/alloc_count.so bench/alloc_count.c
+for ((i = 0; i < lines; i += 4)); do
+    echo 'cd .'
+    echo 'cd "."'
+    echo 'cd . > /dev/null'
+    echo 'cd    .   '
+done > "$script"
+echo exit >> "$script"
+
+LD_PRELOAD=./bench/alloc_count.so ./dsh < "$script" 2>&1 >/dev/null | grep alloc_count
@@ -0,0 +1,55 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "dshlib.h"
+
+/* parse_bench
+ * times build_cmd_list() + free_cmd_list() on a few typical command lines
+ * and reports the cost per line in ns, the parse cost the shell pays on
+ * every line before anything is forked.
+ *
+ *   usage: parse_bench [iterations]
+ */
+#define DEF_ITERS 1000000
+
+static const char *const LINES[] = {
+    "ls -la /tmp",
+    "echo \"hello     world\" > out.txt",
+    "cat < in.txt | grep foo | sort -r >> log.txt",
+    "cmd1 a1 a2 a3 | cmd2 a4 a5 a6 | cmd3 a7 a8 a9",
+};
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char *argv[]) {
+    long iters = argc > 1 ? atol(argv[1]) : DEF_ITERS;
+    command_list_t clist = { 0 };
+    char line[256];
+
+    if (iters <= 0) {
+        fprintf(stderr, "usage: %s [iterations]\n", argv[0]);
+        return 1;
+    }
+    printf("%-48s %10s\n", "line", "ns/line");
+    for (size_t i = 0; i < sizeof(LINES) / sizeof(LINES[0]); i++) {
+        double t0 = now_sec();
+        for (long n = 0; n < iters; n++) {
+            strcpy(line, LINES[i]);    // as the shell passes its line buffer
+            if (build_cmd_list(line, &clist) != OK) {
+                fprintf(stderr, "parse failed: %s\n", LINES[i]);
+                return 1;
+            }
+            free_cmd_list(&clist);
+        }
+        double t = now_sec() - t0;
+        printf("%-48s %10.1f\n", LINES[i], t * 1e9 / iters);
+    }
+    close_cmd_list(&clist);
+    return 0;
+}
@@ -0,0 +1,73 @@
+#define _GNU_SOURCE // environ
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <spawn.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "dshlib.h"
+
+/* path_bench
+ * times starting `true` by name with PATH searched in the child, as
+ * posix_spawnp() and execvp() do, against launch_cmd() on the path cache,
+ * with PATH holding each number of directories below ahead of the one
+ * true is in. every one of them costs the search a failed execve().
+ *
+ *   usage: path_bench [iterations]
+ */
+#define DEF_ITERS 2000
+
+static const int MISSES[] = { 0, 4, 16, 64 };
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char *argv[]) {
+    long iters = argc > 1 ? atol(argv[1]) : DEF_ITERS;
+    char *args[] = { "true", NULL };
+    cmd_buff_t cmd = { .argc = 1, .argv = args };
+    const char *orig = getenv("PATH");
+
+    if (iters <= 0 || !orig) {
+        fprintf(stderr, "usage: %s [iterations]\n", argv[0]);
+        return 1;
+    }
+    printf("%8s %12s %12s %8s\n", "misses", "search_us", "cached_us", "speedup");
+    for (size_t i = 0; i < sizeof(MISSES) / sizeof(MISSES[0]); i++) {
+        size_t len = strlen(orig) + 1;
+        char *path = malloc(len + MISSES[i] * 32);
+        path[0] = '\0';
+        for (int m = 0; m < MISSES[i]; m++)
+            sprintf(path + strlen(path), "/nonexistent/bin%d:", m);
+        strcat(path, orig);
+        setenv("PATH", path, 1);
+
+        double t0 = now_sec();
+        for (long n = 0; n < iters; n++) {
+            pid_t pid;
+            if (posix_spawnp(&pid, args[0], NULL, NULL, args, environ) != 0) {
+                fprintf(stderr, "true not found on PATH\n");
+                return 1;
+            }
+            waitpid(pid, NULL, 0);
+        }
+        double search_us = (now_sec() - t0) * 1e6 / iters;
+
+        t0 = now_sec();
+        for (long n = 0; n < iters; n++) {
+            if (launch_cmd(&cmd, -1, -1) <= 0)
+                return 1;
+            waitpid(cmd.pid, &cmd.status, 0);
+        }
+        double cached_us = (now_sec() - t0) * 1e6 / iters;
+
+        printf("%8d %12.1f %12.1f %7.2fx\n", MISSES[i], search_us, cached_us, search_us / cached_us);
+        free(path);
+    }
+    return 0;
+}
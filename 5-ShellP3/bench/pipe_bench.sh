@@ -0,0 +1,41 @@
+#!/usr/bin/env bash
+# Pipe throughput: a file of SIZE MB (default 256) through pipelines of 1
+# to 8 pipes, cat -u F | cat -u | ... | wc -c, with the kernel's default
+# pipe size and with set pipesize 1M, run from a dsh -f script.  cat -u is
+# never elided, so every byte crosses every pipe.  The last two lines are
+# cat F | wc -c, where dsh hands F to wc and no cat runs, next to the same
+# pipeline with the cat kept.
+#
+#   usage: bench/pipe_bench.sh [size_mb]
+set -e
+cd "$(dirname "$0")/.."
+size=${1:-256}
+data=$(mktemp)
+script=$(mktemp)
+trap 'rm -f "$data" "$script"' EXIT
+head -c "$((size * 1024 * 1024))" /dev/urandom > "$data"
+
+run() {
+    local name=$1 line=$2
+    local t0 t1
+    printf '%s\n' "$line" > "$script"
+    t0=$(date +%s%N)
+    ./dsh -f "$script" > /dev/null
+    t1=$(date +%s%N)
+    printf '%-24s %8.1f ms %8.0f MB/s\n' "$name" \
+        "$(((t1 - t0) / 1000))e-3" "$((size * 1000000000 / (t1 - t0)))"
+}
+
+echo "$size MB, pipe-max-size $(cat /proc/sys/fs/pipe-max-size 2>/dev/null)"
+for ((pipes = 1; pipes <= 8; pipes++)); do
+    line="cat -u $data"
+    for ((i = 1; i < pipes; i++)); do
+        line+=" | cat -u"
+    done
+    line+=" | wc -c"
+    run "$pipes pipes, default" "$line"
+    run "$pipes pipes, pipesize 1M" "set pipesize 1M
+$line"
+done
+run "cat F | wc -c, elided" "cat $data | wc -c"
+run "cat -u F | wc -c" "cat -u $data | wc -c"
@@ -0,0 +1,33 @@
+#!/usr/bin/env bash
+# Times dsh reading a generated script of LINES builtin commands (default
+# 200000) three ways: dsh -f script, dsh -f - < script and plain dsh <
+# script, which still prints a prompt for every line.  The commands are
+# builtins, so the times are the shell's own reading, parsing and output
+# per line, with no process started.
+#
+#   usage: bench/script_bench.sh [lines]
+set -e
+cd "$(dirname "$0")/.."
+lines=${1:-200000}
+script=$(mktemp)
+trap 'rm -f "$script"' EXIT
+
+for ((i = 0; i < lines; i += 2)); do
+    echo 'cd .'
+    echo 'cd "." > /dev/null'
+done > "$script"
+
+run() {
+    local name=$1; shift
+    local t0 t1
+    t0=$(date +%s%N)
+    "$@" > /dev/null 2>&1
+    t1=$(date +%s%N)
+    printf '%-18s %8.1f ms %8.0f ns/line\n' "$name" \
+        "$(((t1 - t0) / 1000))e-3" "$(((t1 - t0) / lines))"
+}
+
+echo "$lines lines"
+run "dsh -f script" ./dsh -f "$script"
+run "dsh -f - < script" sh -c './dsh -f - < "$1"' sh "$script"
+run "dsh < script" sh -c './dsh < "$1"' sh "$script"
@@ -7,7 +7,14 @@
 /* DO NOT EDIT
  * main() logic moved to exec_local_cmd_loop() in dshlib.c
 */
-int main(){
+int main(int argc, char *argv[]){
+  // dsh -f script runs the script with no prompts or banner
+  if (argc == 3 && strcmp(argv[1], SCRIPT_OPT) == 0)
+    return exec_script(argv[2]);
+  if (argc != 1) {
+    fprintf(stderr, "usage: %s [%s script]\n", argv[0], SCRIPT_OPT);
+    return 1;
+  }
   int rc = exec_local_cmd_loop();
   printf("cmd loop returned %d\n", rc);
 }
\ No newline at end of file
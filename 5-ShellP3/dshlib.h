@@ -1,15 +1,16 @@
 #ifndef __DSHLIB_H__
 #define __DSHLIB_H__
 #include <stdbool.h>
+#include <stdio.h>
+#include <sys/types.h>
 #include <errno.h>  // If you use errno-based error handling
 
 //Constants for command structure sizes
 #define EXE_MAX 64
 #define ARG_MAX 256
-#define CMD_MAX 8
-#define CMD_ARGV_MAX (CMD_MAX + 1)
-// Longest command that can be read from the shell
-#define SH_CMD_MAX EXE_MAX + ARG_MAX
+// Starting size of a command list, it doubles when a pipeline is longer.
+// Lines, argument counts and pipeline lengths have no fixed limit.
+#define CMD_LIST_MIN 8
 
 typedef struct command
 {
@@ -20,13 +21,16 @@ typedef struct command
 typedef struct cmd_buff
 {
     int  argc;
-    char *argv[CMD_ARGV_MAX];
+    char **argv;    // NULL terminated, in the command list's arena
     char *_cmd_buffer;
 
     // Extra Credit fields for I/O redirection
     char *infile;   // for '<'
     char *outfile;  // for '>' or '>>'
     bool append;    // true if '>>' was used
+
+    pid_t pid;      // the stage's process while a pipeline runs
+    int status;     // its wait status once it has been reaped
 } cmd_buff_t;
 
 /* WIP - Move to next assignment 
@@ -39,15 +43,31 @@ typedef struct command{
 }command_t;
 */
 
+// Per-line bump arena.  build_cmd_list() copies the line into it once and
+// every token, argv array and redirect filename points into that copy, so
+// no command owns memory of its own.  free_cmd_list() resets used in O(1);
+// the block is kept and only grows when a longer line comes in.
+#define CMD_ARENA_MIN 1024
+
+typedef struct cmd_arena {
+    char   *base;
+    size_t  used;
+    size_t  cap;
+} cmd_arena_t;
+
 typedef struct command_list{
     int num;
-    cmd_buff_t commands[CMD_MAX];
+    int cap;                // commands allocated
+    cmd_buff_t *commands;   // grows by doubling, kept between lines
+    cmd_arena_t arena;
+    bool background;        // the line ended with '&'
 } command_list_t;
 
 // Special character #defines
 #define SPACE_CHAR  ' '
 #define PIPE_CHAR   '|'
 #define PIPE_STRING "|"
+#define BG_CHAR     '&'
 
 // Shell prompt, exit command, etc.
 #define SH_PROMPT "dsh3> "
@@ -68,26 +88,101 @@ typedef struct command_list{
 int alloc_cmd_buff(cmd_buff_t *cmd_buff);
 int free_cmd_buff(cmd_buff_t *cmd_buff);
 int clear_cmd_buff(cmd_buff_t *cmd_buff);
-int build_cmd_buff(char *cmd_line, cmd_buff_t *cmd_buff);
 int close_cmd_buff(cmd_buff_t *cmd_buff);
 int build_cmd_list(char *cmd_line, command_list_t *clist);
 int free_cmd_list(command_list_t *cmd_lst);
+int close_cmd_list(command_list_t *cmd_lst);
 
 // Built-in command stuff
 typedef enum {
     BI_CMD_EXIT,
     BI_CMD_DRAGON,
     BI_CMD_CD,
+    BI_CMD_HASH,
+    BI_CMD_JOBS,
+    BI_CMD_WAIT,
+    BI_CMD_FG,
+    BI_CMD_PARALLEL,
+    BI_CMD_SET,
     BI_NOT_BI,
     BI_EXECUTED,
 } Built_In_Cmds;
 Built_In_Cmds match_command(const char *input); 
 Built_In_Cmds exec_built_in_cmd(cmd_buff_t *cmd);
 
+// Where the command loop reads from.  A script, run with dsh -f, gets no
+// prompts; name is set when errors should carry line numbers.
+#define SCRIPT_OPT       "-f"
+#define SCRIPT_BUFF_SZ   (64 * 1024)    // input is read in blocks this big
+#define SCRIPT_NOT_FOUND 127            // exit status when it cannot be opened
+
+typedef struct cmd_input {
+    FILE *in;
+    const char *name;   // NULL for a terminal
+    long line;          // of the line being run
+    bool script;
+} cmd_input_t;
+
 // Main execution context
 int exec_local_cmd_loop();
+int exec_script(const char *path);
+void cmd_error(const char *fmt, ...);
 int exec_cmd(cmd_buff_t *cmd);
 int execute_pipeline(command_list_t *clist);
+int wait_pipeline(command_list_t *clist, int started);
+int execute_background(command_list_t *clist, const char *cmd_line);
+
+// Shell options, set -o name and set +o name.  pipefail makes a pipeline's
+// status its last failed stage's, failfast stops the other stages when one
+// fails.
+int exec_set(cmd_buff_t *cmd);
+
+// Pipe capacity, set pipesize N.  Pipes between stages get N bytes, up to
+// pipe-max-size; 0 leaves the kernel's default.
+#define PIPESIZE_OPT     "pipesize"
+#define PIPE_MAX_PATH    "/proc/sys/fs/pipe-max-size"
+#define PIPE_MAX_DEFAULT (1024 * 1024)  // pipe-max-size when it cannot be read
+int pipe_open(int fds[2]);
+
+// Background jobs, started by a line ending in '&'.  Finished jobs are
+// reaped between commands, SIGCHLD only writes to a self-pipe.  The jobs,
+// wait and fg builtins use the table.
+#define JOB_LIST_MIN 8
+#define JOB_NOT_FOUND 127   // wait status for a job or pid that is not ours
+void jobs_reap(void);
+void jobs_notify(void);
+void jobs_print(void);
+int jobs_wait(const char *spec);
+int jobs_fg(const char *spec);
+
+// Process launch.  Commands start with posix_spawn; the fork/execvp path is
+// kept as a fallback, picked with set_launch_mode() or DSH_LAUNCH=fork.
+#define LAUNCH_ENV "DSH_LAUNCH"
+typedef enum {
+    LAUNCH_SPAWN,
+    LAUNCH_FORK,
+} launch_mode_t;
+void set_launch_mode(launch_mode_t mode);
+launch_mode_t get_launch_mode(void);
+pid_t launch_cmd(cmd_buff_t *cmd, int in_fd, int out_fd);
+
+// The parallel builtin, xargs -P with the output kept in the order of the
+// args: parallel [-j N] command [{}] [::: arg...]
+#define PAR_ARG      "{}"           // replaced by the arg in each word
+#define PAR_SEP      ":::"          // the args follow, else read from stdin
+#define PAR_JOBS_CPU 4              // -j is capped at this many jobs per CPU
+#define PAR_BACKLOG  4              // jobs ahead of the output, per running job
+#define PAR_COPY_SZ  (64 * 1024)    // output is copied out in blocks this big
+#define PAR_FAIL_MAX 101            // status is the failed job count, up to this
+int exec_parallel(cmd_buff_t *cmd);
+
+// PATH lookup cache, command name to the path found for it.  The hash
+// builtin lists it, hash -r empties it.
+#define PATH_CACHE_MIN 64
+const char *path_cache_lookup(const char *name, bool hit);
+void path_cache_forget(const char *name);
+void path_cache_reset(void);
+void path_cache_print(void);
 
 // Provide prototype for the Dragon ASCII-art printer
 void print_dragon();
@@ -95,6 +190,5 @@ void print_dragon();
 // Output constants
 #define CMD_OK_HEADER       "PARSED COMMAND LINE - TOTAL COMMANDS %d\n"
 #define CMD_WARN_NO_CMD     "warning: no commands provided\n"
-#define CMD_ERR_PIPE_LIMIT  "error: piping limited to %d commands\n"
 
 #endif
\ No newline at end of file
@@ -53,6 +53,38 @@ EOF
   [ "$status" -eq 0 ]
 }
 
+@test "Built-in: hash remembers command paths and hash -r forgets them" {
+  run ./dsh <<EOF
+ls -d /
+ls -d /
+hash
+hash -r
+hash
+exit
+EOF
+  [[ "$output" == *"   2	"*"/ls"* ]]
+  [[ "$output" == *"hash: hash table empty"* ]]
+  [ "$status" -eq 0 ]
+}
+
+@test "Built-in: a cached path that is gone is looked up again" {
+  mkdir -p test_bin1 test_bin2
+  cp /bin/echo test_bin1/hecho
+  cp /bin/echo test_bin2/hecho
+  PATH="$PWD/test_bin1:$PWD/test_bin2:$PATH" run ./dsh <<EOF
+hecho one
+rm test_bin1/hecho
+hecho two
+hash
+exit
+EOF
+  rm -rf test_bin1 test_bin2
+  [[ "$output" == *"two"* ]]
+  [[ "$output" == *"test_bin2/hecho"* ]]
+  [[ "$output" != *"test_bin1/hecho"* ]]
+  [ "$status" -eq 0 ]
+}
+
 ################################################################################
 # Section 3: Quoting and Spacing (Local)
 ################################################################################
@@ -75,6 +107,33 @@ EOF
   [ "$status" -eq 0 ]
 }
 
+@test "Lexer: quoted operators are text, unquoted ones need no spaces" {
+  run ./dsh <<EOF
+echo "a|b > c"|tr a-z A-Z>test_out.txt
+cat test_out.txt
+exit
+EOF
+  [[ "$output" == *"A|B > C"* ]]
+  [ "$status" -eq 0 ]
+  rm -f test_out.txt
+}
+
+@test "Lexer: an empty pipeline stage is an error" {
+  run ./dsh <<EOF
+echo a || echo b
+| echo lead
+echo trail |
+echo ok
+exit
+EOF
+  [[ "$output" != *"b"$'\n'* ]]
+  [[ "$output" != *"lead"$'\n'* ]]
+  [[ "$output" != *"trail"$'\n'* ]]
+  [ "$(grep -c "error building command list" <<< "$output")" -eq 3 ]
+  [[ "$output" == *"ok"* ]]
+  [ "$status" -eq 0 ]
+}
+
 ################################################################################
 # Section 4: Pipeline Tests (Local)
 ################################################################################
@@ -100,15 +159,67 @@ EOF
   [ "$status" -eq 0 ]
 }
 
-@test "Pipeline: Error on too many commands" {
+@test "Pipeline: More than eight commands run" {
+  run ./dsh <<EOF
+echo deep | cat | cat | cat | cat | cat | cat | cat | cat | cat | cat | tr a-z A-Z
+exit
+EOF
+  [[ "$output" == *"DEEP"* ]]
+  [ "$status" -eq 0 ]
+}
+
+@test "Limits: Lines longer than 320 characters with many arguments" {
+  args=$(seq -s ' ' 1 500)
+  run ./dsh <<EOF
+echo $args | wc -w
+exit
+EOF
+  [[ "$output" == *"500"* ]]
+  [ "$status" -eq 0 ]
+}
+
+@test "Pipeline: \$? is the last stage's status, pipefail and failfast change it" {
+  start=$SECONDS
   run ./dsh <<EOF
-cmd1 | cmd2 | cmd3 | cmd4 | cmd5 | cmd6 | cmd7 | cmd8 | cmd9
+sh -c "exit 3" | cat
+echo "plain=\$?"
+set -o pipefail
+sh -c "exit 3" | cat
+echo "pipefail=\$?"
+set -o failfast
+sh -c "exit 2" | sleep 5
+echo "failfast=\$?"
 exit
 EOF
-  [[ "$output" == *"error: piping limited to"* ]]
+  [[ "$output" == *"plain=0"* ]]
+  [[ "$output" == *"pipefail=3"* ]]
+  [[ "$output" == *"failfast=2"* ]]
+  [ $((SECONDS - start)) -lt 4 ]
   [ "$status" -eq 0 ]
 }
 
+@test "Pipeline: set pipesize and a cat at either end give the same output" {
+  seq 1 5000 > test_pipe_in.txt
+  run ./dsh <<EOF
+set pipesize 1M
+set pipesize
+cat test_pipe_in.txt | wc -l
+cat < test_pipe_in.txt | tail -n 1
+cat . | wc -c
+seq 3 | cat > test_pipe_out.txt
+seq 3 | cat >> test_pipe_out.txt
+set pipesize 12x
+exit
+EOF
+  [[ "$output" == *"1048576"* ]]
+  [[ "$output" == *"5000"*"5000"* ]]
+  [[ "$output" == *"12x: invalid pipe size"* ]]
+  [[ "$output" == *"cat: .: Is a directory"* ]]
+  [ "$(cat test_pipe_out.txt | tr -d '\n')" = "123123" ]
+  [ "$status" -eq 0 ]
+  rm -f test_pipe_in.txt test_pipe_out.txt
+}
+
 ################################################################################
 # Section 5: Redirection Tests (Local)
 ################################################################################
@@ -146,8 +257,95 @@ EOF
   rm in.txt
 }
 
+@test "Redirection: output file in the last stage of a pipeline" {
+  run ./dsh <<EOF
+echo "piped line" | tr a-z A-Z > test_out.txt
+cat test_out.txt
+exit
+EOF
+  [[ "$output" == *"PIPED LINE"* ]]
+  [ "$status" -eq 0 ]
+  rm -f test_out.txt
+}
+
+################################################################################
+# Section 6: Process Launch Tests (Local)
+################################################################################
+
+@test "Launch: Fork fallback runs pipelines and redirects" {
+  DSH_LAUNCH=fork run ./dsh <<EOF
+echo "forked line" | tr a-z A-Z > test_out.txt
+cat < test_out.txt
+exit
+EOF
+  [[ "$output" == *"FORKED LINE"* ]]
+  [ "$status" -eq 0 ]
+  rm -f test_out.txt
+}
+
+################################################################################
+# Section 7: Script Mode Tests (Local)
+################################################################################
+
+@test "Script: dsh -f runs a file with no prompts and numbers its errors" {
+  cat > test_script.dsh <<EOF
+# comment line
+
+echo first
+not_a_real_command
+echo second
+EOF
+  run ./dsh -f test_script.dsh
+  [[ "$output" != *"dsh4>"* ]]
+  [[ "$output" != *"local mode"* ]]
+  [[ "$output" == *"first"*"second"* ]]
+  [[ "$output" == *"test_script.dsh: line 4: "* ]]
+  [ "$status" -eq 0 ]
+  rm -f test_script.dsh
+}
+
+################################################################################
+# Section 8: Background Job and Parallel Tests (Local)
+################################################################################
+
+@test "Jobs: & runs in the background, jobs lists it, wait and fg collect it" {
+  run ./dsh <<EOF
+sleep 1 &
+echo "foreground line"
+jobs
+wait
+sh -c "echo from the job" | tr a-z A-Z &
+fg
+jobs
+exit
+EOF
+  [[ "$output" == *"[1] "* ]]
+  [[ "$output" == *"foreground line"* ]]
+  [[ "$output" == *"[1]+  Running                 sleep 1 &"* ]]
+  [[ "$output" == *"FROM THE JOB"* ]]
+  [ "$status" -eq 0 ]
+}
+
+@test "Parallel: runs jobs at once and prints their output in argument order" {
+  printf 'a\nb\n' > test_args.txt
+  run ./dsh <<EOF
+parallel -j 3 sh -c "sleep 0.{}; echo job {}" ::: 3 1 2
+parallel echo from-{} < test_args.txt
+parallel -j
+parallel -j 0 echo ::: x
+parallel -j 1000000000 echo big-{} ::: 1 2
+exit
+EOF
+  [[ "$output" == *"job 3"*"job 1"*"job 2"* ]]
+  [[ "$output" == *"from-a"*"from-b"* ]]
+  [ "$(grep -c "usage: parallel" <<< "$output")" -eq 2 ]
+  [[ "$output" == *"big-1"*"big-2"* ]]
+  [ "$status" -eq 0 ]
+  rm -f test_args.txt
+}
+
 ################################################################################
-# Section 6: Exit and Return Code Tests (Local)
+# Section 9: Exit and Return Code Tests (Local)
 ################################################################################
 
 @test "Exit command: prints 'exiting...' and final status" {
@@ -170,7 +368,7 @@ EOF
 # }
 
 ################################################################################
-# Section 7: Remote Shell Tests
+# Section 10: Remote Shell Tests
 # These tests verify that remote client/server functionality works as specified.
 ################################################################################
 
@@ -231,4 +429,4 @@ EOF
     false
   fi
   teardown
-}
\ No newline at end of file
+}
@@ -0,0 +1,67 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/wait.h>
+
+#include "dshlib.h"
+
+/* spawn_bench
+ * Times launch_cmd() + waitpid() of /bin/true with the posix_spawn and the
+ * fork launchers while the shell holds a heap of each size below, touched
+ * so it is all resident. fork copies the page tables of that heap on every
+ * launch, posix_spawn does not.
+ *
+ *   usage: spawn_bench [iterations]
+ */
+#define DEF_ITERS 2000
+
+static const size_t RSS_MB[] = { 0, 64, 256, 1024 };
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Average microseconds per launch and wait
+static double time_launch(launch_mode_t mode, long iters) {
+    char *argv[] = { "/bin/true", NULL };
+    cmd_buff_t cmd = { .argc = 1, .argv = argv };
+
+    set_launch_mode(mode);
+    double t0 = now_sec();
+    for (long n = 0; n < iters; n++) {
+        if (launch_cmd(&cmd, -1, -1) <= 0) {
+            fprintf(stderr, "Launch failed\n");
+            exit(1);
+        }
+        waitpid(cmd.pid, &cmd.status, 0);
+    }
+    return (now_sec() - t0) * 1e6 / iters;
+}
+
+int main(int argc, char *argv[]) {
+    long iters = argc > 1 ? atol(argv[1]) : DEF_ITERS;
+
+    if (iters <= 0) {
+        fprintf(stderr, "usage: %s [iterations]\n", argv[0]);
+        return 1;
+    }
+    printf("%8s %10s %10s %8s\n", "rss_mb", "spawn_us", "fork_us", "speedup");
+    for (size_t i = 0; i < sizeof(RSS_MB) / sizeof(RSS_MB[0]); i++) {
+        size_t len = RSS_MB[i] * 1024 * 1024;
+        char *heap = len ? malloc(len) : NULL;
+        if (len && !heap) {
+            fprintf(stderr, "Cannot allocate %zu MB\n", RSS_MB[i]);
+            return 1;
+        }
+        if (heap)
+            memset(heap, 1, len);
+        double spawn_us = time_launch(LAUNCH_SPAWN, iters);
+        double fork_us = time_launch(LAUNCH_FORK, iters);
+        printf("%8zu %10.1f %10.1f %7.1fx\n", RSS_MB[i], spawn_us, fork_us, fork_us / spawn_us);
+        free(heap);
+    }
+    return 0;
+}
@@ -12,12 +12,14 @@
 #define MODE_LCLI   0       //Local client
 #define MODE_SCLI   1       //Socket client
 #define MODE_SSVR   2       //Socket server
+#define MODE_LSCR   3       //Local script, -f
 
 typedef struct cmd_args{
   int   mode;
   char  ip[16];   //e.g., 192.168.100.101\0
   int   port;
   int   threaded_server;
+  char  *script;  //-f file, - for stdin
 }cmd_args_t;
 
 //You dont really need to understand this but the C runtime library provides
@@ -26,10 +28,11 @@ typedef struct cmd_args{
 //with passing optional connection parameters. 
 
 void print_usage(const char *progname) {
-  printf("Usage: %s [-c | -s] [-i IP] [-p PORT] [-x] [-h]\n", progname);
+  printf("Usage: %s [-c | -s | -f FILE] [-i IP] [-p PORT] [-x] [-h]\n", progname);
   printf("  Default is to run %s in local mode\n", progname);
   printf("  -c            Run as client\n");
   printf("  -s            Run as server\n");
+  printf("  -f FILE       Run a script with no prompts, - reads it from stdin\n");
   printf("  -i IP         Set IP/Interface address (only valid with -c or -s)\n");
   printf("  -p PORT       Set port number (only valid with -c or -s)\n");
   printf("  -x            Enable threaded mode (only valid with -s)\n");
@@ -45,7 +48,7 @@ void parse_args(int argc, char *argv[], cmd_args_t *cargs) {
   cargs->mode = MODE_LCLI;
   cargs->port = RDSH_DEF_PORT;
 
-  while ((opt = getopt(argc, argv, "csi:p:xh")) != -1) {
+  while ((opt = getopt(argc, argv, "csf:i:p:xh")) != -1) {
       switch (opt) {
           case 'c':
               if (cargs->mode != MODE_LCLI) {
@@ -63,8 +66,16 @@ void parse_args(int argc, char *argv[], cmd_args_t *cargs) {
               cargs->mode = MODE_SSVR;
               strncpy(cargs->ip, RDSH_DEF_SVR_INTFACE, sizeof(cargs->ip) - 1);
               break;
+          case 'f':
+              if (cargs->mode != MODE_LCLI) {
+                  fprintf(stderr, "Error: -f can only be used in local mode\n");
+                  exit(EXIT_FAILURE);
+              }
+              cargs->mode = MODE_LSCR;
+              cargs->script = optarg;
+              break;
           case 'i':
-              if (cargs->mode == MODE_LCLI) {
+              if (cargs->mode == MODE_LCLI || cargs->mode == MODE_LSCR) {
                   fprintf(stderr, "Error: -i can only be used with -c or -s\n");
                   exit(EXIT_FAILURE);
               }
@@ -72,7 +83,7 @@ void parse_args(int argc, char *argv[], cmd_args_t *cargs) {
               cargs->ip[sizeof(cargs->ip) - 1] = '\0';  // Ensure null termination
               break;
           case 'p':
-              if (cargs->mode == MODE_LCLI) {
+              if (cargs->mode == MODE_LCLI || cargs->mode == MODE_LSCR) {
                   fprintf(stderr, "Error: -p can only be used with -c or -s\n");
                   exit(EXIT_FAILURE);
               }
@@ -121,6 +132,9 @@ int main(int argc, char *argv[]){
       printf("local mode\n");
       rc = exec_local_cmd_loop();
       break;
+    case MODE_LSCR:
+      //no banners, the script's status is the exit status
+      return exec_script(cargs.script);
     case MODE_SCLI:
       printf("socket client mode:  addr:%s:%d\n", cargs.ip, cargs.port);
       rc = exec_remote_cmd_loop(cargs.ip, cargs.port);
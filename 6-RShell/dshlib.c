@@ -1,10 +1,21 @@
+#define _GNU_SOURCE // pipe2(), strndup(), memfd_create()
 #include <stdlib.h>
 #include <stdio.h>
+#include <stdarg.h>
 #include <string.h>
 #include <ctype.h>
 #include <stdbool.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <spawn.h>
+#include <signal.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/sendfile.h>
+#include <sys/syscall.h>
+#include <sys/stat.h>
 #include <sys/wait.h>
 #include <errno.h>
 #include "dshlib.h"
@@ -12,6 +23,9 @@
 // global variable to store the return code of the last executed command
 int last_return_code = 0;
 
+// Input the command loop is reading, for the line numbers in cmd_error().
+static cmd_input_t *cur_input;
+
 /* trim_whitespace
  * removes leading and trailing whitespace from the provided string
  */
@@ -38,14 +52,14 @@ void trim_whitespace(char *str) {
 void setup_redirection(cmd_buff_t *cmd) {
     if (cmd->input_file) {
         int fd = open(cmd->input_file, O_RDONLY);
-        if (fd < 0) { perror("open input_file"); exit(EXIT_FAILURE); }
+        if (fd < 0) { cmd_error("open input_file: %s\n", strerror(errno)); exit(EXIT_FAILURE); }
         if (dup2(fd, STDIN_FILENO) < 0) { perror("dup2 input_file"); close(fd); exit(EXIT_FAILURE); }
         close(fd);
     }
     if (cmd->output_file) {
         int flags = O_WRONLY | O_CREAT | (cmd->append_mode ? O_APPEND : O_TRUNC);
         int fd = open(cmd->output_file, flags, 0666);
-        if (fd < 0) { perror("open output_file"); exit(EXIT_FAILURE); }
+        if (fd < 0) { cmd_error("open output_file: %s\n", strerror(errno)); exit(EXIT_FAILURE); }
         if (dup2(fd, STDOUT_FILENO) < 0) { perror("dup2 output_file"); close(fd); exit(EXIT_FAILURE); }
         close(fd);
     }
@@ -67,7 +81,7 @@ Built_In_Cmds exec_built_in_cmd(cmd_buff_t *cmd) {
     if (strcmp(cmd->argv[0], "cd") == 0) {
         if (cmd->argc > 1) {
             if (chdir(cmd->argv[1]) != 0) { 
-                perror("cd failed"); 
+                cmd_error("cd failed: %s\n", strerror(errno)); 
                 last_return_code = ERR_EXEC_CMD; 
             } else {
                 last_return_code = 0;
@@ -75,6 +89,50 @@ Built_In_Cmds exec_built_in_cmd(cmd_buff_t *cmd) {
         }
         return BI_CMD_CD;
     }
+    // handle hash: list the path cache, forget it with -r or fill it
+    if (strcmp(cmd->argv[0], "hash") == 0) {
+        last_return_code = 0;
+        if (cmd->argc == 1) {
+            path_cache_print();
+        } else if (strcmp(cmd->argv[1], "-r") == 0) {
+            path_cache_reset();
+        } else {
+            char path[PATH_MAX];
+            for (int i = 1; i < cmd->argc; i++) {
+                if (!path_cache_lookup(cmd->argv[i], false, path, sizeof(path))) {
+                    cmd_error("hash: %s: not found\n", cmd->argv[i]);
+                    last_return_code = 1;
+                }
+            }
+        }
+        return BI_CMD_HASH;
+    }
+    // handle the job builtins: jobs lists them, wait and fg wait for them
+    if (strcmp(cmd->argv[0], "jobs") == 0) {
+        jobs_print();
+        last_return_code = 0;
+        return BI_CMD_JOBS;
+    }
+    if (strcmp(cmd->argv[0], "wait") == 0) {
+        last_return_code = jobs_wait(cmd->argc > 1 ? cmd->argv[1] : NULL);
+        for (int i = 2; i < cmd->argc; i++)
+            last_return_code = jobs_wait(cmd->argv[i]);
+        return BI_CMD_WAIT;
+    }
+    if (strcmp(cmd->argv[0], "fg") == 0) {
+        last_return_code = jobs_fg(cmd->argc > 1 ? cmd->argv[1] : NULL);
+        return BI_CMD_FG;
+    }
+    // handle set: shell options, set -o lists them
+    if (strcmp(cmd->argv[0], "set") == 0) {
+        last_return_code = exec_set(cmd);
+        return BI_CMD_SET;
+    }
+    // handle parallel: runs a command over many arguments, N at a time
+    if (strcmp(cmd->argv[0], "parallel") == 0) {
+        last_return_code = exec_parallel(cmd);
+        return BI_CMD_PARALLEL;
+    }
     // handle dragon command to print ascii art
     if (strcmp(cmd->argv[0], "dragon") == 0) { 
         print_dragon(); 
@@ -83,183 +141,1298 @@ Built_In_Cmds exec_built_in_cmd(cmd_buff_t *cmd) {
     return BI_NOT_BI;
 }
 
-/* exec_cmd
- * executes a single external command by forking a child process.
- * The child sets up any file redirection and then calls execvp.
+/* match_command
+ * Returns the builtin input names, BI_NOT_BI if it is not one.
  */
-int exec_cmd(cmd_buff_t *cmd) {
+Built_In_Cmds match_command(const char *input) {
+    static const struct { const char *name; Built_In_Cmds bi; } BUILTINS[] = {
+        { EXIT_CMD, BI_CMD_EXIT }, { "dragon", BI_CMD_DRAGON }, { "cd", BI_CMD_CD },
+        { "stop-server", BI_CMD_STOP_SVR }, { "hash", BI_CMD_HASH }, { "jobs", BI_CMD_JOBS },
+        { "wait", BI_CMD_WAIT }, { "fg", BI_CMD_FG }, { "parallel", BI_CMD_PARALLEL },
+        { "set", BI_CMD_SET },
+    };
+    for (size_t i = 0; i < sizeof(BUILTINS) / sizeof(BUILTINS[0]); i++) {
+        if (strcmp(input, BUILTINS[i].name) == 0)
+            return BUILTINS[i].bi;
+    }
+    return BI_NOT_BI;
+}
+
+/* shell options
+ * "set -o name" turns one on, "set +o name" turns it off and "set -o"
+ * alone lists them. "set pipesize N" sets the capacity of the pipes
+ * between stages, with a K or M suffix, 0 for the kernel's default.
+ */
+static bool opt_failfast;   // the first stage to fail stops the rest
+static bool opt_pipefail;   // a pipeline's status is its last failed stage's
+static size_t opt_pipesize; // bytes, 0 leaves the pipes alone
+
+static const struct { const char *name; bool *flag; } SHELL_OPTS[] = {
+    { "failfast", &opt_failfast }, { "pipefail", &opt_pipefail },
+};
+
+/* pipe_max_size
+ * The largest capacity an unprivileged pipe can be given, read once from
+ * /proc/sys/fs/pipe-max-size.
+ */
+static size_t pipe_max_size(void) {
+    static size_t max;
+    if (max == 0) {
+        FILE *f = fopen(PIPE_MAX_PATH, "re");
+        unsigned long n;
+        max = (f && fscanf(f, "%lu", &n) == 1 && n > 0) ? n : PIPE_MAX_DEFAULT;
+        if (f)
+            fclose(f);
+    }
+    return max;
+}
+
+/* set_pipesize
+ * "set pipesize [N[K|M]]", prints the size without N. A size above
+ * pipe-max-size is lowered to it.
+ */
+static int set_pipesize(const char *arg) {
+    if (!arg) {
+        printf("%zu\n", opt_pipesize);
+        return 0;
+    }
+    char *end;
+    unsigned long n = strtoul(arg, &end, 10);
+    if (*end == 'k' || *end == 'K')
+        n *= 1024, end++;
+    else if (*end == 'm' || *end == 'M')
+        n *= 1024 * 1024, end++;
+    if (end == arg || *end != '\0' || arg[0] == '-') {
+        cmd_error("set: %s: invalid pipe size\n", arg);
+        return 1;
+    }
+    opt_pipesize = n < pipe_max_size() ? n : pipe_max_size();
+    return 0;
+}
+
+/* exec_set
+ * The set builtin, returns 1 for an unknown option.
+ */
+int exec_set(cmd_buff_t *cmd) {
+    size_t nopts = sizeof(SHELL_OPTS) / sizeof(SHELL_OPTS[0]);
+    if (cmd->argc > 1 && strcmp(cmd->argv[1], PIPESIZE_OPT) == 0)
+        return set_pipesize(cmd->argc > 2 ? cmd->argv[2] : NULL);
+    if (cmd->argc <= 2) {
+        for (size_t k = 0; k < nopts; k++)
+            printf("%-15s\t%s\n", SHELL_OPTS[k].name, *SHELL_OPTS[k].flag ? "on" : "off");
+        printf("%-15s\t%zu\n", PIPESIZE_OPT, opt_pipesize);
+        return 0;
+    }
+    for (int i = 1; i < cmd->argc; i += 2) {
+        bool on = strcmp(cmd->argv[i], "-o") == 0;
+        if ((!on && strcmp(cmd->argv[i], "+o") != 0) || i + 1 == cmd->argc) {
+            cmd_error("usage: set [-o|+o] [name]\n");
+            return 1;
+        }
+        size_t k = 0;
+        while (k < nopts && strcmp(cmd->argv[i + 1], SHELL_OPTS[k].name) != 0)
+            k++;
+        if (k == nopts) {
+            cmd_error("set: %s: invalid option name\n", cmd->argv[i + 1]);
+            return 1;
+        }
+        *SHELL_OPTS[k].flag = on;
+    }
+    return 0;
+}
+
+/* path cache
+ * Command name -> absolute path, so a command found on PATH once is
+ * started with execve() on that path instead of execvp() trying every
+ * PATH directory again in each child. Chained hash table, filled in the
+ * shell itself on first use. It is dropped when PATH changes and an entry
+ * is dropped when its path fails to run. The threaded server's client
+ * threads share it, so every entry point takes path_lock and a lookup
+ * copies the path out before the lock is dropped.
+ */
+typedef struct path_entry {
+    struct path_entry *next;
+    char *name;
+    char *path;
+    int hits;
+} path_entry_t;
+
+static path_entry_t **path_buckets;
+static size_t path_nbuckets;    // a power of two, 0 before the first use
+static size_t path_count;
+static char *path_env;          // PATH the entries were found with
+static pthread_mutex_t path_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// FNV-1a
+static size_t path_hash(const char *name) {
+    size_t h = 2166136261u;
+    for (const unsigned char *p = (const unsigned char *)name; *p; p++)
+        h = (h ^ *p) * 16777619u;
+    return h;
+}
+
+// Forgets every entry, path_lock is held
+static void path_cache_clear(void) {
+    for (size_t b = 0; b < path_nbuckets; b++) {
+        path_entry_t *e = path_buckets[b];
+        while (e) {
+            path_entry_t *next = e->next;
+            free(e);
+            e = next;
+        }
+        path_buckets[b] = NULL;
+    }
+    path_count = 0;
+    free(path_env);
+    path_env = NULL;
+}
+
+/* path_cache_reset
+ * Forgets every entry, for hash -r.
+ */
+void path_cache_reset(void) {
+    pthread_mutex_lock(&path_lock);
+    path_cache_clear();
+    pthread_mutex_unlock(&path_lock);
+}
+
+// Drop the table if PATH is not what the entries were found with
+static void path_cache_check_env(void) {
+    const char *env = getenv("PATH");
+    if (!env)
+        env = "";
+    if (path_env && strcmp(path_env, env) == 0)
+        return;
+    path_cache_clear();
+    path_env = strdup(env);
+}
+
+static path_entry_t **path_slot(const char *name) {
+    path_entry_t **e = &path_buckets[path_hash(name) & (path_nbuckets - 1)];
+    while (*e && strcmp((*e)->name, name) != 0)
+        e = &(*e)->next;
+    return e;
+}
+
+// Double the buckets once there are more entries than buckets
+static int path_cache_grow(void) {
+    size_t n = path_nbuckets ? path_nbuckets * 2 : PATH_CACHE_MIN;
+    path_entry_t **b = calloc(n, sizeof(*b));
+    if (!b)
+        return ERR_MEMORY;
+    for (size_t i = 0; i < path_nbuckets; i++) {
+        path_entry_t *e = path_buckets[i];
+        while (e) {
+            path_entry_t *next = e->next;
+            size_t at = path_hash(e->name) & (n - 1);
+            e->next = b[at];
+            b[at] = e;
+            e = next;
+        }
+    }
+    free(path_buckets);
+    path_buckets = b;
+    path_nbuckets = n;
+    return OK;
+}
+
+/* find_in_path
+ * Searches PATH like execvp() for a regular, executable file called name.
+ * An empty PATH entry is the current directory. Returns the entry it
+ * makes, or NULL.
+ */
+static path_entry_t *find_in_path(const char *name) {
+    const char *dir = path_env;
+    size_t name_len = strlen(name);
+    while (dir) {
+        const char *end = strchr(dir, ':');
+        size_t dir_len = end ? (size_t)(end - dir) : strlen(dir);
+        // One block for the entry, its name and its path
+        path_entry_t *e = malloc(sizeof(*e) + 2 * name_len + dir_len + 3);
+        if (!e)
+            return NULL;
+        e->name = (char *)(e + 1);
+        e->path = e->name + name_len + 1;
+        memcpy(e->name, name, name_len + 1);
+        if (dir_len == 0) {
+            memcpy(e->path, name, name_len + 1);
+        } else {
+            memcpy(e->path, dir, dir_len);
+            e->path[dir_len] = '/';
+            memcpy(e->path + dir_len + 1, name, name_len + 1);
+        }
+        struct stat st;
+        if (stat(e->path, &st) == 0 && S_ISREG(st.st_mode) && access(e->path, X_OK) == 0)
+            return e;
+        free(e);
+        dir = end ? end + 1 : NULL;
+    }
+    return NULL;
+}
+
+/* path_cache_lookup
+ * Copies the path to run name with into buf, searching PATH only when
+ * name is not cached yet. Hit counts the lookup as a use of the command.
+ * Returns buf, or NULL for a name with a '/', which is run as it is, a
+ * name that is not found and a path longer than size.
+ */
+const char *path_cache_lookup(const char *name, bool hit, char *buf, size_t size) {
+    if (strchr(name, '/') || *name == '\0')
+        return NULL;
+    const char *found = NULL;
+    pthread_mutex_lock(&path_lock);
+    path_cache_check_env();
+    if (!path_nbuckets && path_cache_grow() != OK)
+        goto out;
+    path_entry_t **slot = path_slot(name);
+    if (!*slot) {
+        path_entry_t *e = find_in_path(name);
+        if (!e)
+            goto out;
+        e->next = NULL;
+        e->hits = 0;
+        *slot = e;
+        if (++path_count > path_nbuckets)
+            path_cache_grow();   // the table still works if this fails
+        slot = path_slot(name);
+    }
+    if (hit)
+        (*slot)->hits++;
+    if (strlen((*slot)->path) < size)
+        found = strcpy(buf, (*slot)->path);
+out:
+    pthread_mutex_unlock(&path_lock);
+    return found;
+}
+
+/* path_cache_forget
+ * Drops name, when its cached path could not be run.
+ */
+void path_cache_forget(const char *name) {
+    pthread_mutex_lock(&path_lock);
+    if (path_nbuckets) {
+        path_entry_t **slot = path_slot(name);
+        if (*slot) {
+            path_entry_t *e = *slot;
+            *slot = e->next;
+            free(e);
+            path_count--;
+        }
+    }
+    pthread_mutex_unlock(&path_lock);
+}
+
+/* path_cache_print
+ * The hash builtin with no arguments, the same listing as bash.
+ */
+void path_cache_print(void) {
+    pthread_mutex_lock(&path_lock);
+    if (path_count == 0) {
+        printf("hash: hash table empty\n");
+    } else {
+        printf("hits\tcommand\n");
+        for (size_t b = 0; b < path_nbuckets; b++) {
+            for (path_entry_t *e = path_buckets[b]; e; e = e->next)
+                printf("%4d\t%s\n", e->hits, e->path);
+        }
+    }
+    pthread_mutex_unlock(&path_lock);
+}
+
+/* launch mode
+ * Commands start with posix_spawn unless set_launch_mode() or
+ * DSH_LAUNCH=fork in the environment picks the fork path.
+ */
+static int launch_mode = -1;
+
+void set_launch_mode(launch_mode_t mode) {
+    launch_mode = mode;
+}
+
+launch_mode_t get_launch_mode(void) {
+    if (launch_mode < 0) {
+        const char *want = getenv(LAUNCH_ENV);
+        launch_mode = (want && strcmp(want, "fork") == 0) ? LAUNCH_FORK : LAUNCH_SPAWN;
+    }
+    return launch_mode;
+}
+
+/* launch_fork
+ * The fallback launcher: fork, then the child moves in_fd and out_fd onto
+ * stdin and stdout, applies the command's own redirection and execs. The
+ * path is looked up and checked before the fork so the cache lives in the
+ * shell, where a stale entry can still be forgotten.
+ */
+static pid_t launch_fork(cmd_buff_t *cmd, int in_fd, int out_fd) {
+    char buf[PATH_MAX];
+    const char *path = path_cache_lookup(cmd->argv[0], true, buf, sizeof(buf));
+    if (path && access(path, X_OK) != 0) {
+        path_cache_forget(cmd->argv[0]);   // stale, search PATH once more
+        path = path_cache_lookup(cmd->argv[0], true, buf, sizeof(buf));
+    }
     pid_t pid = fork();
-    if (pid < 0) { 
-        perror("fork failed"); 
-        last_return_code = ERR_MEMORY; 
-        return ERR_MEMORY; 
+    if (pid < 0) {
+        perror("fork");
+        return -1;
     }
     if (pid == 0) {
-        // In child: set up redirection and execute the command.
+        if (in_fd >= 0 && dup2(in_fd, STDIN_FILENO) < 0) {
+            perror("dup2");
+            exit(EXIT_FAILURE);
+        }
+        if (out_fd >= 0 && dup2(out_fd, STDOUT_FILENO) < 0) {
+            perror("dup2");
+            exit(EXIT_FAILURE);
+        }
+        // Set up any file redirection for this command
         setup_redirection(cmd);
-        if (execvp(cmd->argv[0], cmd->argv) == -1) { 
-            perror("execvp"); 
-            exit(EXIT_FAILURE); 
+        if (path)
+            execve(path, cmd->argv, environ);  // a stale path falls through
+        if (execvp(cmd->argv[0], cmd->argv) == -1) {
+            cmd_error("execvp: %s\n", strerror(errno));
+            exit(EXIT_FAILURE);
         }
+    }
+    return pid;
+}
+
+/* open_redirect
+ * Opens cmd's output_file, or its input_file, in the shell itself, close
+ * on exec and with the same flags the child would use. Errors are
+ * reported here.
+ */
+static int open_redirect(cmd_buff_t *cmd, bool out) {
+    int fd;
+    if (out) {
+        int flags = O_WRONLY | O_CREAT | O_CLOEXEC | (cmd->append_mode ? O_APPEND : O_TRUNC);
+        fd = open(cmd->output_file, flags, 0666);
     } else {
-        int status;
-        waitpid(pid, &status, 0);
-        last_return_code = WEXITSTATUS(status);
-        return last_return_code;
+        fd = open(cmd->input_file, O_RDONLY | O_CLOEXEC);
+    }
+    if (fd < 0)
+        cmd_error("open %s: %s\n", out ? "output_file" : "input_file", strerror(errno));
+    return fd;
+}
+
+/* launch_spawn
+ * posix_spawn with file actions for the dup2s, on the path cache's path
+ * for the command. glibc runs the child with clone(CLONE_VM | CLONE_VFORK),
+ * so no page tables are copied however big the shell is. The redirect
+ * files are opened here in the parent, close on exec, so errors name the
+ * file just like the fork path.
+ */
+static pid_t launch_spawn(cmd_buff_t *cmd, int in_fd, int out_fd) {
+    int in_file = -1, out_file = -1;
+    if (cmd->input_file) {
+        in_file = open_redirect(cmd, false);
+        if (in_file < 0) {
+            cmd->status = W_EXITCODE(EXIT_FAILURE, 0);
+            return 0;
+        }
+        in_fd = in_file;
     }
+    if (cmd->output_file) {
+        out_file = open_redirect(cmd, true);
+        if (out_file < 0) {
+            if (in_file >= 0)
+                close(in_file);
+            cmd->status = W_EXITCODE(EXIT_FAILURE, 0);
+            return 0;
+        }
+        out_fd = out_file;
+    }
+
+    posix_spawn_file_actions_t fa;
+    pid_t pid = 0;
+    int err = posix_spawn_file_actions_init(&fa);
+    if (err == 0 && in_fd >= 0)
+        err = posix_spawn_file_actions_adddup2(&fa, in_fd, STDIN_FILENO);
+    if (err == 0 && out_fd >= 0)
+        err = posix_spawn_file_actions_adddup2(&fa, out_fd, STDOUT_FILENO);
+    if (err == 0) {
+        char buf[PATH_MAX];
+        const char *path = path_cache_lookup(cmd->argv[0], true, buf, sizeof(buf));
+        if (path) {
+            err = posix_spawn(&pid, path, &fa, NULL, cmd->argv, environ);
+            if (err != 0) {
+                path_cache_forget(cmd->argv[0]);   // stale, search PATH once more
+                if ((path = path_cache_lookup(cmd->argv[0], true, buf, sizeof(buf))))
+                    err = posix_spawn(&pid, path, &fa, NULL, cmd->argv, environ);
+            }
+        } else {
+            err = posix_spawnp(&pid, cmd->argv[0], &fa, NULL, cmd->argv, environ);
+        }
+    }
+    posix_spawn_file_actions_destroy(&fa);
+    if (in_file >= 0)
+        close(in_file);
+    if (out_file >= 0)
+        close(out_file);
+    if (err != 0) {
+        // Reported and counted as if the child had failed to exec
+        cmd_error("execvp: %s\n", strerror(err));
+        cmd->status = W_EXITCODE(EXIT_FAILURE, 0);
+        return 0;
+    }
+    return pid;
+}
+
+/* launch_cmd
+ * Starts cmd with stdin from in_fd and stdout to out_fd, -1 keeps the
+ * shell's, then applies the command's own redirection. The pid is also
+ * kept in cmd->pid. Returns 0 if the command could not be started, with
+ * cmd->status set as if it had exited, and -1 if no process could be
+ * created at all. File descriptors the child should not keep must be
+ * close on exec.
+ */
+pid_t launch_cmd(cmd_buff_t *cmd, int in_fd, int out_fd) {
+    cmd->status = 0;
+    if (get_launch_mode() == LAUNCH_FORK)
+        cmd->pid = launch_fork(cmd, in_fd, out_fd);
+    else
+        cmd->pid = launch_spawn(cmd, in_fd, out_fd);
+    return cmd->pid;
+}
+
+/* exit_code
+ * The exit code for a wait status, 128 + the signal for a process that
+ * was killed, like sh.
+ */
+static int exit_code(int status) {
+    return WIFSIGNALED(status) ? 128 + WTERMSIG(status) : WEXITSTATUS(status);
+}
+
+// A stage that failed; one killed by SIGPIPE only lost its reader
+static bool stage_failed(int status) {
+    return WIFSIGNALED(status) ? WTERMSIG(status) != SIGPIPE : WEXITSTATUS(status) != 0;
+}
+
+/* exec_cmd
+ * Executes a single external command with launch_cmd() and waits for it.
+ */
+int exec_cmd(cmd_buff_t *cmd) {
+    if (launch_cmd(cmd, -1, -1) < 0) { 
+        last_return_code = ERR_MEMORY; 
+        return ERR_MEMORY; 
+    }
+    if (cmd->pid > 0)
+        waitpid(cmd->pid, &cmd->status, 0);
+    last_return_code = exit_code(cmd->status);
     return last_return_code;
 }
 
-/* execute_pipeline
- * sets up pipes between commands in a pipeline and forks a child for each command.
- * Each child applies pipe redirection then any file redirection before executing the command.
+/* pipe_open
+ * pipe2() close on exec, with the capacity "set pipesize" asked for. A
+ * capacity the kernel refuses, over the user's pipe quota, leaves the
+ * default.
  */
-int execute_pipeline(command_list_t *clist) {
+int pipe_open(int fds[2]) {
+    if (pipe2(fds, O_CLOEXEC) < 0)
+        return -1;
+    if (opt_pipesize > 0)
+        fcntl(fds[1], F_SETPIPE_SZ, (int)opt_pipesize);
+    return 0;
+}
+
+/* cat elision
+ * A stage that only copies a file, "cat FILE" or "cat < FILE" first in a
+ * pipeline or "cat > FILE" last, is not run. The file is opened here and
+ * handed to the stage next to it, which reads or writes it directly, so
+ * there is no cat process and no copy through a pipe at all. A source
+ * that cannot be opened or is not a regular file, and a sink that cannot
+ * be opened, leave the cat to run and report it as usual.
+ */
+static int cat_source(command_list_t *clist) {
+    cmd_buff_t *cmd = &clist->commands[0];
+    if (clist->num < 2 || strcmp(cmd->argv[0], "cat") != 0 || cmd->output_file ||
+        clist->commands[1].input_file)
+        return -1;
+    const char *file = cmd->argc == 2 && !cmd->input_file ? cmd->argv[1]
+                     : cmd->argc == 1 ? cmd->input_file : NULL;
+    if (!file || file[0] == '-')
+        return -1;
+    // Only a regular file, cat reports a directory or a missing file itself
+    int fd = open(file, O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    if (fd >= 0 && (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode))) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static int cat_sink(command_list_t *clist) {
+    cmd_buff_t *cmd = &clist->commands[clist->num - 1];
+    if (clist->num < 2 || strcmp(cmd->argv[0], "cat") != 0 || cmd->argc != 1 ||
+        cmd->input_file || !cmd->output_file || clist->commands[clist->num - 2].output_file)
+        return -1;
+    int flags = O_WRONLY | O_CREAT | O_CLOEXEC | (cmd->append_mode ? O_APPEND : O_TRUNC);
+    return open(cmd->output_file, flags, 0666);
+}
+
+/* launch_pipeline
+ * Launches every command in the pipeline with launch_cmd(). Each pipe is
+ * created with pipe_open() just before the stage that writes to it, so
+ * the shell never holds more than two pipe fds, the children only keep
+ * the ends moved onto their stdin and stdout, and the length of the
+ * pipeline is not limited. A cat at either end that is elided counts as
+ * started, with status 0. Every stage's pid is kept in its cmd_buff_t
+ * and the number launched in *started, they have to be waited for even
+ * on error.
+ */
+static int launch_pipeline(command_list_t *clist, int *started) {
     int num = clist->num;
-    if (num < 1)
-        return WARN_NO_CMDS;
-    if (num > CMD_MAX) { 
-        fprintf(stderr, CMD_ERR_PIPE_LIMIT, CMD_MAX); 
-        fprintf(stderr, "\n"); 
-        return ERR_TOO_MANY_COMMANDS; 
-    }
-    int pipes[CMD_MAX - 1][2];
-    // Create necessary pipes.
-    for (int i = 0; i < num - 1; i++) { 
-        if (pipe(pipes[i]) < 0) { 
-            perror("pipe"); 
-            return ERR_MEMORY; 
-        } 
-    }
-    pid_t pids[CMD_MAX];
+    int in_fd = -1;     // read end of the previous stage's pipe
+    int rc = OK;
+    *started = 0;
     for (int i = 0; i < num; i++) {
-        pid_t pid = fork();
-        if (pid < 0) { 
-            perror("fork"); 
-            return ERR_MEMORY; 
-        }
-        if (pid == 0) {
-            // For non-first command, set previous pipe as STDIN.
-            if (i > 0 && dup2(pipes[i - 1][0], STDIN_FILENO) < 0) { 
-                perror("dup2"); 
-                exit(EXIT_FAILURE); 
+        cmd_buff_t *cmd = &clist->commands[i];
+        int fds[2] = { -1, -1 };
+        // A leading cat is not run, the next stage reads its file
+        if (i == 0 && (in_fd = cat_source(clist)) >= 0) {
+            cmd->pid = 0;
+            cmd->status = 0;
+            (*started)++;
+            continue;
+        }
+        // Nor is a trailing one, this stage writes its file
+        int sink = i == num - 2 ? cat_sink(clist) : -1;
+        if (sink >= 0) {
+            fds[1] = sink;
+        } else if (i < num - 1 && pipe_open(fds) < 0) {
+            // Every stage but the last writes into a new pipe
+            cmd_error("pipe: %s\n", strerror(errno));
+            rc = ERR_MEMORY;
+            break;
+        }
+        pid_t pid = launch_cmd(cmd, in_fd, fds[1]);
+        // Parent keeps only the read end, for the next stage
+        if (in_fd >= 0)
+            close(in_fd);
+        if (fds[1] >= 0)
+            close(fds[1]);
+        in_fd = fds[0];
+        if (pid < 0) {
+            rc = ERR_MEMORY;
+            break;
+        }
+        (*started)++;
+        if (sink >= 0) {
+            clist->commands[num - 1].pid = 0;
+            clist->commands[num - 1].status = 0;
+            (*started)++;
+            break;
+        }
+    }
+    if (in_fd >= 0)
+        close(in_fd);
+    return rc;
+}
+
+/* background jobs
+ * A line ending in '&' is a job: the pids of its stages, their wait
+ * statuses and the line, for jobs and fg. The table is an array that
+ * doubles when it is full, ids count up from the highest in use like
+ * bash. SIGCHLD only writes a byte to a close on exec, non blocking
+ * self-pipe; jobs_reap() runs between commands, drains it and collects
+ * the jobs' children with WNOHANG, so the shell only ever waits for pids
+ * it started and a finished job does not stay a zombie for long.
+ */
+typedef struct job_proc {
+    pid_t pid;
+    int status;
+    bool done;          // reaped, or never started
+} job_proc_t;
+
+typedef struct job {
+    int id;
+    int num;            // stages
+    int running;        // stages not reaped yet
+    job_proc_t *procs;
+    char *text;         // the line without its '&'
+} job_t;
+
+static job_t *jobs;
+static int jobs_num;
+static int jobs_cap;
+static int chld_pipe[2] = { -1, -1 };
+
+static void on_sigchld(int sig) {
+    (void)sig;
+    int saved = errno;
+    ssize_t n = write(chld_pipe[1], "", 1); // a full pipe already has a wakeup
+    (void)n;
+    errno = saved;
+}
+
+/* jobs_init
+ * Creates the self-pipe and installs the SIGCHLD handler, the first time
+ * a job is started.
+ */
+static int jobs_init(void) {
+    if (chld_pipe[0] >= 0)
+        return OK;
+    if (pipe2(chld_pipe, O_CLOEXEC | O_NONBLOCK) < 0)
+        return ERR_MEMORY;
+    struct sigaction sa = { 0 };
+    sa.sa_handler = on_sigchld;
+    sa.sa_flags = SA_RESTART | SA_NOCLDSTOP;
+    sigemptyset(&sa.sa_mask);
+    if (sigaction(SIGCHLD, &sa, NULL) < 0) {
+        close(chld_pipe[0]);
+        close(chld_pipe[1]);
+        chld_pipe[0] = chld_pipe[1] = -1;
+        return ERR_MEMORY;
+    }
+    return OK;
+}
+
+/* job_add
+ * Adds the first started stages of clist as a job, text is the line.
+ */
+static job_t *job_add(command_list_t *clist, int started, const char *text) {
+    if (jobs_num == jobs_cap) {
+        int cap = jobs_cap ? jobs_cap * 2 : JOB_LIST_MIN;
+        job_t *grown = realloc(jobs, cap * sizeof(*grown));
+        if (!grown)
+            return NULL;
+        jobs = grown;
+        jobs_cap = cap;
+    }
+    // The line without leading spaces and its trailing '&'
+    text += strspn(text, " \t");
+    size_t len = strlen(text);
+    while (len > 0 && (isspace((unsigned char)text[len - 1]) || text[len - 1] == BG_CHAR))
+        len--;
+    job_t *j = &jobs[jobs_num];
+    j->procs = malloc(started * sizeof(*j->procs));
+    j->text = strndup(text, len);
+    if (!j->procs || !j->text) {
+        free(j->procs);
+        free(j->text);
+        return NULL;
+    }
+    j->id = jobs_num ? jobs[jobs_num - 1].id + 1 : 1;
+    j->num = started;
+    j->running = 0;
+    for (int i = 0; i < started; i++) {
+        cmd_buff_t *cmd = &clist->commands[i];
+        j->procs[i] = (job_proc_t){ cmd->pid, cmd->status, cmd->pid <= 0 };
+        if (cmd->pid > 0)
+            j->running++;
+    }
+    jobs_num++;
+    return j;
+}
+
+// The pid of the job's last stage that was started, bash prints it
+static pid_t job_pid(const job_t *j) {
+    for (int i = j->num - 1; i > 0; i--) {
+        if (j->procs[i].pid > 0)
+            return j->procs[i].pid;
+    }
+    return j->procs[0].pid;
+}
+
+static void job_remove(int i) {
+    free(jobs[i].procs);
+    free(jobs[i].text);
+    memmove(&jobs[i], &jobs[i + 1], (jobs_num - i - 1) * sizeof(*jobs));
+    jobs_num--;
+}
+
+/* job_update
+ * Collects the job's stages that have finished, options is 0 to wait
+ * for all of them or WNOHANG.
+ */
+static void job_update(job_t *j, int options) {
+    for (int i = 0; i < j->num && j->running > 0; i++) {
+        job_proc_t *p = &j->procs[i];
+        if (p->done)
+            continue;
+        pid_t r = waitpid(p->pid, &p->status, options);
+        if (r == p->pid || (r < 0 && errno == ECHILD)) {
+            p->done = true;
+            j->running--;
+        }
+    }
+}
+
+// A job's exit code is its last stage's, or with pipefail its last failed one's
+static int job_status(const job_t *j) {
+    for (int i = j->num - 1; opt_pipefail && i >= 0; i--) {
+        if (exit_code(j->procs[i].status) != 0)
+            return exit_code(j->procs[i].status);
+    }
+    return exit_code(j->procs[j->num - 1].status);
+}
+
+/* job_line
+ * Prints a job like bash's jobs does, + marks the current job and - the
+ * one before it.
+ */
+static void job_line(int i) {
+    const job_t *j = &jobs[i];
+    char state[32];
+    char mark = i == jobs_num - 1 ? '+' : i == jobs_num - 2 ? '-' : ' ';
+    if (j->running)
+        snprintf(state, sizeof(state), "Running");
+    else if (job_status(j) == 0)
+        snprintf(state, sizeof(state), "Done");
+    else
+        snprintf(state, sizeof(state), "Exit %d", job_status(j));
+    printf("[%d]%c  %-24s%s%s\n", j->id, mark, state, j->text, j->running ? " &" : "");
+}
+
+/* jobs_reap
+ * Collects the children of every job that have finished, if a SIGCHLD
+ * came in since the last call. Cheap when nothing happened.
+ */
+void jobs_reap(void) {
+    char buf[64];
+    bool woke = false;
+    if (chld_pipe[0] < 0)
+        return;
+    while (read(chld_pipe[0], buf, sizeof(buf)) > 0)
+        woke = true;
+    if (!woke)
+        return;
+    for (int i = 0; i < jobs_num; i++) {
+        if (jobs[i].running)
+            job_update(&jobs[i], WNOHANG);
+    }
+}
+
+/* jobs_notify
+ * Reports the jobs that have finished and drops them from the table,
+ * before the next prompt.
+ */
+void jobs_notify(void) {
+    jobs_reap();
+    for (int i = 0; i < jobs_num; i++) {
+        if (jobs[i].running == 0) {
+            job_line(i);
+            job_remove(i--);
+        }
+    }
+}
+
+/* jobs_print
+ * The jobs builtin, lists every job and drops the finished ones.
+ */
+void jobs_print(void) {
+    jobs_reap();
+    for (int i = 0; i < jobs_num; i++)
+        job_line(i);
+    for (int i = 0; i < jobs_num; i++) {
+        if (jobs[i].running == 0)
+            job_remove(i--);
+    }
+}
+
+/* job_find
+ * Index of the job spec names, NULL for the current one. "%N" is job N;
+ * a plain N is a job id, or a pid of one of its stages when by_pid is set.
+ */
+static int job_find(const char *spec, bool by_pid) {
+    if (!spec)
+        return jobs_num - 1;
+    if (*spec == '%') {
+        spec++;
+        by_pid = false;
+    }
+    char *end;
+    long n = strtol(spec, &end, 10);
+    if (*spec == '\0' || *end != '\0')
+        return -1;
+    for (int i = 0; i < jobs_num; i++) {
+        if (!by_pid && jobs[i].id == n)
+            return i;
+        for (int k = 0; by_pid && k < jobs[i].num; k++) {
+            if (jobs[i].procs[k].pid == n)
+                return i;
+        }
+    }
+    return -1;
+}
+
+// Waits for job i, drops it and returns its exit code
+static int job_wait(int i) {
+    job_update(&jobs[i], 0);
+    int rc = job_status(&jobs[i]);
+    job_remove(i);
+    return rc;
+}
+
+/* jobs_wait
+ * The wait builtin: waits for the job or pid spec names, or for every job
+ * when it is NULL. Returns the exit code of the job waited for.
+ */
+int jobs_wait(const char *spec) {
+    if (!spec) {
+        while (jobs_num > 0)
+            job_wait(0);
+        return 0;
+    }
+    int i = job_find(spec, true);
+    if (i < 0) {
+        cmd_error("wait: %s: no such job\n", spec);
+        return JOB_NOT_FOUND;
+    }
+    return job_wait(i);
+}
+
+/* jobs_fg
+ * The fg builtin: prints the job's line and waits for it, the current job
+ * when spec is NULL. The stages share the shell's terminal already, so
+ * there is no process group to hand over.
+ */
+int jobs_fg(const char *spec) {
+    int i = job_find(spec, false);
+    if (i < 0) {
+        cmd_error("fg: %s: no such job\n", spec ? spec : "current");
+        return 1;
+    }
+    printf("%s\n", jobs[i].text);
+    fflush(stdout);
+    return job_wait(i);
+}
+
+static int pidfd_open(pid_t pid) {
+#ifdef SYS_pidfd_open
+    return syscall(SYS_pidfd_open, pid, 0);    // always close on exec
+#else
+    (void)pid;
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+/* wait_pipeline
+ * Reaps the first started stages of clist as they finish, in any order,
+ * by polling a pidfd for each. Without pidfds (Linux before 5.3) it polls
+ * the SIGCHLD self-pipe instead. Every stage's wait status is kept in its
+ * cmd_buff_t. With failfast set, the first stage that fails gets the rest
+ * sent SIGTERM, so a pipeline whose producer died does not hang on its
+ * consumer. Returns the pipeline's exit code: the first failure's after
+ * failfast, else the last stage's, or with pipefail the last failed one's.
+ */
+int wait_pipeline(command_list_t *clist, int started) {
+    cmd_buff_t *cmds = clist->commands;
+    struct pollfd *pfds = malloc(started * sizeof(*pfds));
+    if (!pfds) {
+        // No room to poll, wait in order
+        for (int i = 0; i < started; i++) {
+            if (cmds[i].pid > 0)
+                waitpid(cmds[i].pid, &cmds[i].status, 0);
+        }
+        return exit_code(cmds[started - 1].status);
+    }
+    bool pidfds = true;
+    int left = 0;
+    for (int i = 0; i < started; i++) {
+        pfds[i] = (struct pollfd){ -1, 0, 0 };      // events marks a running stage
+        if (cmds[i].pid <= 0)
+            continue;
+        pfds[i].events = POLLIN;
+        left++;
+        if (pidfds && (pfds[i].fd = pidfd_open(cmds[i].pid)) < 0)
+            pidfds = false;
+    }
+    if (!pidfds) {
+        for (int i = 0; i < started; i++) {
+            if (pfds[i].fd >= 0)
+                close(pfds[i].fd);
+            pfds[i].fd = -1;
+        }
+        jobs_init();
+    }
+
+    int failed_at = -1;
+    while (left > 0) {
+        for (int i = 0; i < started; i++) {
+            if (!pfds[i].events || (pidfds && !pfds[i].revents))
+                continue;
+            if (waitpid(cmds[i].pid, &cmds[i].status, WNOHANG) != cmds[i].pid)
+                continue;
+            if (pfds[i].fd >= 0)
+                close(pfds[i].fd);
+            pfds[i] = (struct pollfd){ -1, 0, 0 };
+            left--;
+            if (opt_failfast && failed_at < 0 && stage_failed(cmds[i].status)) {
+                failed_at = i;
+                for (int k = 0; k < started; k++) {
+                    if (pfds[k].events)
+                        kill(cmds[k].pid, SIGTERM);
+                }
             }
-            // For non-last command, set current pipe as STDOUT.
-            if (i < num - 1 && dup2(pipes[i][1], STDOUT_FILENO) < 0) { 
-                perror("dup2"); 
-                exit(EXIT_FAILURE); 
+        }
+        if (left == 0)
+            break;
+        if (pidfds) {
+            poll(pfds, started, -1);
+        } else {
+            struct pollfd chld = { chld_pipe[0], POLLIN, 0 };
+            if (poll(&chld, 1, -1) > 0)
+                jobs_reap();
+        }
+    }
+    free(pfds);
+
+    if (failed_at >= 0)
+        return exit_code(cmds[failed_at].status);
+    for (int i = started - 1; opt_pipefail && i >= 0; i--) {
+        if (exit_code(cmds[i].status) != 0)
+            return exit_code(cmds[i].status);
+    }
+    return exit_code(cmds[started - 1].status);
+}
+
+/* execute_pipeline
+ * Launches the pipeline and reaps its stages with wait_pipeline(), which
+ * sets the exit code.
+ */
+int execute_pipeline(command_list_t *clist) {
+    if (clist->num < 1)
+        return WARN_NO_CMDS;
+    int started;
+    int rc = launch_pipeline(clist, &started);
+    if (started > 0)
+        last_return_code = wait_pipeline(clist, started);
+    return rc;
+}
+
+/* execute_background
+ * Starts the pipeline without waiting for it and adds it to the job
+ * table. Like bash, the job id and the pid of the last stage are printed
+ * unless a script is running. Builtins run in the shell itself, so they
+ * cannot be put in the background.
+ */
+int execute_background(command_list_t *clist, const char *cmd_line) {
+    if (clist->num == 1 && match_command(clist->commands[0].argv[0]) != BI_NOT_BI) {
+        cmd_error("%s: builtins cannot run in the background\n", clist->commands[0].argv[0]);
+        last_return_code = 1;
+        return OK;
+    }
+    if (jobs_init() != OK) {
+        cmd_error("sigaction: %s\n", strerror(errno));
+        return ERR_MEMORY;
+    }
+    int started;
+    int rc = launch_pipeline(clist, &started);
+    if (started == 0)
+        return rc;
+    job_t *j = job_add(clist, started, cmd_line);
+    if (!j) {
+        // No room to track it, run it in the foreground instead
+        for (int i = 0; i < started; i++) {
+            if (clist->commands[i].pid > 0)
+                waitpid(clist->commands[i].pid, &clist->commands[i].status, 0);
+        }
+        return ERR_MEMORY;
+    }
+    if (!cur_input || !cur_input->script)
+        fprintf(stderr, "[%d] %d\n", j->id, (int)job_pid(j));
+    last_return_code = 0;
+    return rc;
+}
+
+
+/* parallel
+ * The parallel [-j N] command [args] [::: arg...] builtin runs the
+ * command once per arg, like xargs -P. {} in a word is replaced by the
+ * arg, with no {} the arg is added at the end. The args come after :::,
+ * otherwise one per line from the builtin's input_file or the shell's
+ * stdin. At most N jobs run at once, N defaults to the number of CPUs.
+ * Each job's stdout goes to a memfd of its own and is copied out, to
+ * stdout or the builtin's output_file, in the order of the args as soon
+ * as the jobs before it have finished; stderr is not held back. Jobs are
+ * started with launch_cmd() and waited for through the SIGCHLD
+ * self-pipe, so background jobs are untouched.
+ */
+typedef struct par_slot {
+    cmd_buff_t cmd;     // the job, its argv is one malloc'd block
+    int out;            // memfd with its stdout
+    bool done;
+} par_slot_t;
+
+/* par_argv
+ * The job's argv: the template words with {} replaced by arg, or arg
+ * added after them. Pointers and strings are one block.
+ */
+static char **par_argv(char **tmpl, int n, const char *arg) {
+    size_t alen = strlen(arg);
+    size_t chars = 0;
+    bool placed = false;
+    for (int i = 0; i < n; i++) {
+        size_t k = 0;
+        for (const char *p = tmpl[i]; (p = strstr(p, PAR_ARG)); p += 2)
+            k++;
+        chars += strlen(tmpl[i]) + k * alen + 1;
+        placed = placed || k > 0;
+    }
+    if (!placed)
+        chars += alen + 1;
+    char **argv = malloc((n + 2) * sizeof(char *) + chars);
+    if (!argv)
+        return NULL;
+    char *out = (char *)(argv + n + 2);
+    int c = 0;
+    for (int i = 0; i < n; i++) {
+        argv[c++] = out;
+        for (const char *p = tmpl[i]; *p; ) {
+            if (strncmp(p, PAR_ARG, 2) == 0) {
+                memcpy(out, arg, alen);
+                out += alen;
+                p += 2;
+            } else {
+                *out++ = *p++;
             }
-            // Close all pipe fds in the child.
-            for (int j = 0; j < num - 1; j++) { 
-                close(pipes[j][0]); 
-                close(pipes[j][1]); 
+        }
+        *out++ = '\0';
+    }
+    if (!placed) {
+        argv[c++] = out;
+        memcpy(out, arg, alen + 1);
+    }
+    argv[c] = NULL;
+    return argv;
+}
+
+/* par_read_args
+ * Reads one arg per line from in until its end. The lines stay in *text,
+ * which the caller frees with the returned array.
+ */
+static char **par_read_args(FILE *in, char **text, int *count) {
+    size_t cap = 0, len = 0;
+    char *buf = NULL;
+    char chunk[4096];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), in)) > 0) {
+        if (len + n + 1 > cap) {
+            cap = cap ? cap : sizeof(chunk);
+            while (len + n + 1 > cap)
+                cap *= 2;
+            char *grown = realloc(buf, cap);
+            if (!grown) {
+                free(buf);
+                return NULL;
             }
-            // Set up file redirection for this command.
-            setup_redirection(&clist->commands[i]);
-            if (execvp(clist->commands[i].argv[0], clist->commands[i].argv) == -1) { 
-                perror("execvp"); 
-                exit(EXIT_FAILURE); 
+            buf = grown;
+        }
+        memcpy(buf + len, chunk, n);
+        len += n;
+    }
+    int num = 0, slots = 0;
+    char **args = NULL;
+    for (size_t i = 0; i < len; ) {
+        char *nl = memchr(buf + i, '\n', len - i);
+        size_t end = nl ? (size_t)(nl - buf) : len;
+        buf[end] = '\0';
+        if (end > i) {      // blank lines are skipped
+            if (num == slots) {
+                slots = slots ? slots * 2 : CMD_LIST_MIN;
+                char **grown = realloc(args, slots * sizeof(*args));
+                if (!grown) {
+                    free(args);
+                    free(buf);
+                    return NULL;
+                }
+                args = grown;
             }
-        } else { 
-            pids[i] = pid; 
+            args[num++] = buf + i;
         }
+        i = end + 1;
     }
-    // Parent: close all pipe file descriptors.
-    for (int i = 0; i < num - 1; i++) { 
-        close(pipes[i][0]); 
-        close(pipes[i][1]); 
+    *text = buf;
+    *count = num;
+    return args ? args : malloc(sizeof(*args));
+}
+
+/* par_reap
+ * Waits until at least one of the running jobs has finished and marks
+ * every one that has. Any SIGCHLD also updates the background jobs.
+ */
+static void par_reap(par_slot_t *slots, size_t window, int *running) {
+    struct pollfd pfd = { chld_pipe[0], POLLIN, 0 };
+    int before = *running;
+    while (before > 0 && *running == before) {
+        for (size_t i = 0; i < window; i++) {
+            par_slot_t *s = &slots[i];
+            if (s->cmd.argv && !s->done && s->cmd.pid > 0 &&
+                waitpid(s->cmd.pid, &s->cmd.status, WNOHANG) == s->cmd.pid) {
+                s->done = true;
+                (*running)--;
+            }
+        }
+        if (*running == before && poll(&pfd, 1, -1) > 0)
+            jobs_reap();
     }
-    int status;
-    // Wait for all child processes.
-    for (int i = 0; i < num; i++) { 
-        waitpid(pids[i], &status, 0); 
+}
+
+/* par_flush
+ * Copies a finished job's output out and frees its slot. The memfd goes
+ * to the output with sendfile(), in the kernel; where that is refused it
+ * is read and written through buf.
+ */
+static int par_flush(par_slot_t *s, FILE *out, char *buf) {
+    ssize_t n;
+    off_t off = 0;
+    int rc = OK;
+    if (fflush(out) != 0)
+        rc = ERR_EXEC_CMD;
+    while ((n = sendfile(fileno(out), s->out, &off, PAR_COPY_SZ)) > 0)
+        ;
+    if (n < 0 && (errno == EINVAL || errno == ENOSYS)) {
+        lseek(s->out, off, SEEK_SET);
+        while ((n = read(s->out, buf, PAR_COPY_SZ)) > 0) {
+            if (fwrite(buf, 1, n, out) != (size_t)n)
+                rc = ERR_EXEC_CMD;
+        }
+    } else if (n < 0) {
+        rc = ERR_EXEC_CMD;
     }
-    return OK;
+    close(s->out);
+    free(s->cmd.argv);
+    s->cmd.argv = NULL;
+    return rc;
 }
 
-/* build_cmd_buff
- * Parses a single command line (without pipes) into a command buffer.
- * Tokenizes arguments, handling quotes, and detects I/O redirection symbols.
+/* exec_parallel
+ * The parallel builtin. Returns the number of jobs that failed, up to
+ * PAR_FAIL_MAX, or 1 if it could not run them.
  */
-int build_cmd_buff(char *cmd_line, cmd_buff_t *cmd_buff) {
-    if (!cmd_line || strlen(cmd_line) == 0)
-        return WARN_NO_CMDS;
-    // Initialize redirection fields.
-    cmd_buff->input_file = NULL; 
-    cmd_buff->output_file = NULL; 
-    cmd_buff->append_mode = false;
-    // Duplicate the command string for safe tokenization.
-    cmd_buff->_cmd_buffer = strdup(cmd_line);
-    if (!cmd_buff->_cmd_buffer)
-        return ERR_MEMORY;
-    int argc = 0; 
-    bool in_quotes = false; 
-    char *arg_start = NULL;
-    // Tokenize by space, honoring quotes.
-    for (char *cursor = cmd_buff->_cmd_buffer; *cursor; cursor++) {
-        if (*cursor == '"') { 
-            in_quotes = !in_quotes; 
-            *cursor = '\0'; 
-            if (in_quotes) 
-                arg_start = cursor + 1; 
-        } else if (!in_quotes && isspace((unsigned char)*cursor)) { 
-            *cursor = '\0'; 
-            if (arg_start) { 
-                cmd_buff->argv[argc++] = arg_start; 
-                arg_start = NULL; 
-            } 
-        } else { 
-            if (!arg_start) 
-                arg_start = cursor; 
-        }
-    }
-    if (arg_start)
-        cmd_buff->argv[argc++] = arg_start;
-    cmd_buff->argv[argc] = NULL; 
-    cmd_buff->argc = argc;
-    // Process I/O redirection symbols and remove them from argv.
-    int i = 0;
-    while (i < argc) {
-        if (strcmp(cmd_buff->argv[i], "<") == 0) {
-            if (i + 1 < argc) { 
-                cmd_buff->input_file = cmd_buff->argv[i + 1]; 
-                for (int j = i; j < argc - 2; j++) 
-                    cmd_buff->argv[j] = cmd_buff->argv[j + 2]; 
-                argc -= 2; 
-            } else break;
-        } else if (strcmp(cmd_buff->argv[i], ">>") == 0) {
-            if (i + 1 < argc) { 
-                cmd_buff->output_file = cmd_buff->argv[i + 1]; 
-                cmd_buff->append_mode = true; 
-                for (int j = i; j < argc - 2; j++) 
-                    cmd_buff->argv[j] = cmd_buff->argv[j + 2]; 
-                argc -= 2; 
-            } else break;
-        } else if (strcmp(cmd_buff->argv[i], ">") == 0) {
-            if (i + 1 < argc) { 
-                cmd_buff->output_file = cmd_buff->argv[i + 1]; 
-                cmd_buff->append_mode = false; 
-                for (int j = i; j < argc - 2; j++) 
-                    cmd_buff->argv[j] = cmd_buff->argv[j + 2]; 
-                argc -= 2; 
-            } else break;
-        } else {
-            i++;
+int exec_parallel(cmd_buff_t *cmd) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cpus < 1)
+        cpus = 1;
+    long jobs_max = cpus;
+    int first = 1;
+    if (cmd->argc > 1 && strcmp(cmd->argv[1], "-j") == 0) {
+        char *end = NULL;
+        errno = 0;
+        jobs_max = cmd->argc > 2 ? strtol(cmd->argv[2], &end, 10) : 0;
+        if (!end || end == cmd->argv[2] || *end != '\0' || errno == ERANGE)
+            jobs_max = 0;   // not a number, rejected below
+        first = 3;
+    }
+    int sep = first;
+    while (sep < cmd->argc && strcmp(cmd->argv[sep], PAR_SEP) != 0)
+        sep++;
+    if (jobs_max < 1 || sep <= first) {
+        cmd_error("usage: parallel [-j N] command [%s] [%s arg...]\n", PAR_ARG, PAR_SEP);
+        return 1;
+    }
+    if (jobs_max > cpus * PAR_JOBS_CPU)
+        jobs_max = cpus * PAR_JOBS_CPU;   // more would only queue up
+
+    // The args, after ::: or one per line of the input
+    char **args = cmd->argv + sep + 1;
+    int nargs = cmd->argc - sep - 1;
+    char **read_args = NULL;
+    char *text = NULL;
+    if (sep == cmd->argc) {
+        FILE *in = stdin;
+        if (cmd->input_file) {
+            int fd = open_redirect(cmd, false);
+            if (fd < 0 || !(in = fdopen(fd, "r"))) {
+                if (fd >= 0)
+                    close(fd);
+                return 1;
+            }
         }
+        args = read_args = par_read_args(in, &text, &nargs);
+        if (in != stdin)
+            fclose(in);
+        if (!args)
+            return ERR_MEMORY;
     }
-    cmd_buff->argv[argc] = NULL; 
-    cmd_buff->argc = argc;
-    return OK;
+
+    FILE *out = stdout;
+    if (cmd->output_file) {
+        int fd = open_redirect(cmd, true);
+        if (fd < 0 || !(out = fdopen(fd, "w"))) {
+            if (fd >= 0)
+                close(fd);
+            free(read_args);
+            free(text);
+            return 1;
+        }
+    }
+
+    // A job more than window args ahead of the output waits, so a slow
+    // job only holds back that many memfds
+    size_t window = (size_t)jobs_max * PAR_BACKLOG;
+    par_slot_t *slots = calloc(window, sizeof(*slots));
+    char *buf = malloc(PAR_COPY_SZ);
+    int failed = 0, running = 0, rc = OK;
+    int next_start = 0, next_print = 0;
+    if (!slots || !buf || jobs_init() != OK)
+        rc = ERR_MEMORY;
+    while (rc == OK && next_print < nargs) {
+        while (running < jobs_max && next_start < nargs && (size_t)(next_start - next_print) < window) {
+            par_slot_t *s = &slots[next_start % window];
+            s->cmd = (cmd_buff_t){ 0 };
+            s->done = false;
+            s->cmd.argv = par_argv(cmd->argv + first, sep - first, args[next_start]);
+            s->out = memfd_create("dsh-parallel", MFD_CLOEXEC);
+            if (!s->cmd.argv || s->out < 0) {
+                cmd_error("parallel: %s\n", strerror(s->out < 0 ? errno : ENOMEM));
+                if (s->out >= 0)
+                    close(s->out);
+                free(s->cmd.argv);
+                s->cmd.argv = NULL;
+                rc = ERR_MEMORY;
+                break;
+            }
+            while (s->cmd.argv[s->cmd.argc])
+                s->cmd.argc++;
+            if (launch_cmd(&s->cmd, -1, s->out) < 0) {
+                close(s->out);
+                free(s->cmd.argv);
+                s->cmd.argv = NULL;
+                rc = ERR_MEMORY;
+                break;
+            }
+            s->done = s->cmd.pid == 0;
+            running += !s->done;
+            next_start++;
+        }
+        // Print every finished job that is next in order
+        while (next_print < next_start && slots[next_print % window].done) {
+            par_slot_t *s = &slots[next_print % window];
+            failed += exit_code(s->cmd.status) != 0;
+            if (par_flush(s, out, buf) != OK)
+                rc = ERR_EXEC_CMD;
+            next_print++;
+        }
+        if (rc == OK && next_print < nargs)
+            par_reap(slots, window, &running);
+    }
+    // After an error, the jobs already started are still waited for
+    for (int i = next_print; slots && i < next_start; i++) {
+        par_slot_t *s = &slots[i % window];
+        if (!s->done && s->cmd.pid > 0)
+            waitpid(s->cmd.pid, &s->cmd.status, 0);
+        par_flush(s, out, buf);
+    }
+    if (out != stdout)
+        fclose(out);
+    free(buf);
+    free(slots);
+    free(read_args);
+    free(text);
+    if (rc != OK)
+        return rc == ERR_MEMORY ? 1 : rc;
+    return failed < PAR_FAIL_MAX ? failed : PAR_FAIL_MAX;
 }
 
 /* free_cmd_buff
- * Frees the duplicated command string and resets the command buffer fields.
+ * Resets the command buffer fields. The text they point to is owned by the
+ * command list's arena.
  */
 int free_cmd_buff(cmd_buff_t *cmd_buff) {
-    if (cmd_buff->_cmd_buffer) { 
-        free(cmd_buff->_cmd_buffer); 
-        cmd_buff->_cmd_buffer = NULL; 
-    }
+    cmd_buff->_cmd_buffer = NULL; 
     cmd_buff->argc = 0; 
     cmd_buff->input_file = NULL; 
     cmd_buff->output_file = NULL; 
@@ -267,109 +1440,379 @@ int free_cmd_buff(cmd_buff_t *cmd_buff) {
     return OK;
 }
 
+/* arena_begin
+ * Empties the arena and makes sure it can hand out n bytes. This is the
+ * only place the block is (re)allocated, so pointers handed out for a
+ * line never move.
+ */
+static int arena_begin(cmd_arena_t *arena, size_t n) {
+    arena->used = 0;
+    if (n <= arena->cap)
+        return OK;
+    size_t cap = arena->cap ? arena->cap : CMD_ARENA_MIN;
+    while (cap < n)
+        cap *= 2;
+    char *base = malloc(cap);
+    if (!base)
+        return ERR_MEMORY;
+    free(arena->base);
+    arena->base = base;
+    arena->cap = cap;
+    return OK;
+}
+
+/* arena_alloc
+ * Hands out n bytes from the arena, NULL if arena_begin did not reserve them.
+ */
+static void *arena_alloc(cmd_arena_t *arena, size_t n) {
+    if (arena->cap - arena->used < n)
+        return NULL;
+    char *p = arena->base + arena->used;
+    arena->used += n;
+    return p;
+}
+
+// Character classes for the lexer, anything not listed is part of a word
+enum { CH_WORD, CH_SPACE, CH_PIPE, CH_IN, CH_OUT, CH_QUOTE, CH_BG, CH_END };
+
+static const unsigned char LEX_CLASS[256] = {
+    ['\0'] = CH_END,
+    [' '] = CH_SPACE, ['\t'] = CH_SPACE, ['\n'] = CH_SPACE,
+    ['\v'] = CH_SPACE, ['\f'] = CH_SPACE, ['\r'] = CH_SPACE,
+    [PIPE_CHAR] = CH_PIPE, ['<'] = CH_IN, ['>'] = CH_OUT, ['"'] = CH_QUOTE,
+    [BG_CHAR] = CH_BG,
+};
+
+// What the next word is for: an argument or the file of a redirect
+typedef enum { LEX_ARG, LEX_IN, LEX_OUT, LEX_APPEND } lex_target_t;
+
+// Lexer state for one line
+typedef struct lexer {
+    command_list_t *clist;
+    cmd_buff_t *cmd;        // command being built, NULL after a pipe
+    char **args;            // next free argv slot in the arena
+    lex_target_t target;
+} lexer_t;
+
+/* lex_cmd
+ * Makes sure there is a current command, starting the next one in the
+ * list when the line or a pipe has just begun. The list doubles when it
+ * is full; nothing else points into it while a line is being lexed.
+ */
+static int lex_cmd(lexer_t *lx, char *text) {
+    command_list_t *clist = lx->clist;
+    if (lx->cmd)
+        return OK;
+    if (clist->num == clist->cap) {
+        int cap = clist->cap ? clist->cap * 2 : CMD_LIST_MIN;
+        cmd_buff_t *cmds = realloc(clist->commands, cap * sizeof(*cmds));
+        if (!cmds)
+            return ERR_MEMORY;
+        clist->commands = cmds;
+        clist->cap = cap;
+    }
+    cmd_buff_t *c = &clist->commands[clist->num++];
+    c->argc = 0;
+    c->argv = lx->args;         // grows in place, commands are lexed in order
+    c->argv[0] = NULL;
+    lx->args++;
+    c->_cmd_buffer = text;
+    c->input_file = NULL;
+    c->output_file = NULL;
+    c->append_mode = false;
+    c->pid = -1;
+    c->status = 0;
+    lx->cmd = c;
+    return OK;
+}
+
+/* lex_word
+ * Stores a finished word as the file of a pending redirect or as the next
+ * argument of the current command.
+ */
+static int lex_word(lexer_t *lx, char *word) {
+    int rc = lex_cmd(lx, word);
+    if (rc != OK)
+        return rc;
+    cmd_buff_t *c = lx->cmd;
+    switch (lx->target) {
+        case LEX_IN:
+            c->input_file = word;
+            break;
+        case LEX_OUT:
+        case LEX_APPEND:
+            c->output_file = word;
+            c->append_mode = (lx->target == LEX_APPEND);
+            break;
+        case LEX_ARG:
+            c->argv[c->argc++] = word;
+            c->argv[c->argc] = NULL;
+            lx->args++;
+            break;
+    }
+    lx->target = LEX_ARG;
+    return OK;
+}
+
 /* build_cmd_list
- * Splits a pipeline command line on the '|' character into separate commands,
- * and builds a command buffer for each sub-command.
+ * Single pass, table driven lexer. Walks the line once, classifying each
+ * character with LEX_CLASS and copying each word into the list's arena
+ * with its quotes removed, starting a new command at every unquoted '|'
+ * and capturing '<', '>' and '>>' with the word after them as they are
+ * met, so argv never has to be searched or shifted. A '&' at the end of
+ * the line sets clist->background and $? becomes the last exit code, in
+ * quotes too. Operators need no spaces around them and are plain text
+ * inside quotes. An empty stage, "a || b", "| a" or "a |", is an error.
+ * cmd_line itself is not modified. There is no limit on the length of the
+ * line, the number of arguments or the number of commands.
  */
 int build_cmd_list(char *cmd_line, command_list_t *clist) {
-    if (!cmd_line || strlen(cmd_line) == 0)
-        return WARN_NO_CMDS;
     clist->num = 0;
-    char *saveptr, *token = strtok_r(cmd_line, PIPE_STRING, &saveptr);
-    while (token) {
-        // Trim leading whitespace.
-        while (isspace((unsigned char)*token)) token++;
-        // Trim trailing whitespace.
-        char *end = token + strlen(token) - 1;
-        while (end > token && isspace((unsigned char)*end)) { *end = '\0'; end--; }
-        if (strlen(token) > 0) {
-            if (clist->num >= CMD_MAX)
-                return ERR_TOO_MANY_COMMANDS;
-            int rc = build_cmd_buff(token, &clist->commands[clist->num]);
-            if (rc != OK)
-                return rc;
-            clist->num++;
+    clist->background = false;
+    if (!cmd_line)
+        return WARN_NO_CMDS;
+    // Argv slots: every word has a character of the line and every
+    // command's NULL but the last has its '|'. A word is never longer
+    // than twice its text, counting its '\0' and $? as 3 digits.
+    size_t len = strlen(cmd_line);
+    size_t slots = (len + 1) * sizeof(char *);
+    size_t cap = 2 * len + 1;
+    if (arena_begin(&clist->arena, slots + cap) != OK)
+        return ERR_MEMORY;
+    lexer_t lx = { clist, NULL, arena_alloc(&clist->arena, slots), LEX_ARG };
+    char *out = arena_alloc(&clist->arena, cap);
+    char *word = NULL;              // start of the word being copied
+    bool in_quotes = false;
+    int rc = OK;
+
+    for (const char *p = cmd_line; ; p++) {
+        int cls = LEX_CLASS[(unsigned char)*p];
+        if (in_quotes && cls != CH_QUOTE && cls != CH_END)
+            cls = CH_WORD;
+        if (cls == CH_WORD || cls == CH_QUOTE) {
+            if (!word)
+                word = out;         // "" is an empty argument
+            if (cls == CH_QUOTE) {
+                in_quotes = !in_quotes;
+            } else if (p[0] == '$' && p[1] == '?') {
+                // At most 3 digits for its 2 characters, within the reserve
+                out += sprintf(out, "%d", last_return_code < 0 ? 1 : last_return_code);
+                p++;
+            } else {
+                *out++ = *p;
+            }
+            continue;
+        }
+        // A space, an operator or the end of the line ends the word
+        if (word) {
+            *out++ = '\0';
+            rc = lex_word(&lx, word);
+            word = NULL;
+        }
+        if (rc != OK || cls == CH_END)
+            break;
+        if (cls == CH_PIPE) {
+            if (lx.target != LEX_ARG)
+                break;
+            if (!lx.cmd) {
+                rc = ERR_CMD_ARGS_BAD;  // '|' with no command before it
+                break;
+            }
+            lx.cmd = NULL;
+        } else if (cls == CH_BG) {
+            // '&' runs the line in the background, it has to end the line
+            if (lx.target != LEX_ARG)
+                break;
+            if (p[1 + strspn(p + 1, " \t\n\v\f\r")] != '\0') {
+                rc = ERR_CMD_ARGS_BAD;
+                break;
+            }
+            clist->background = true;
+        } else if (cls == CH_IN || cls == CH_OUT) {
+            if (lx.target != LEX_ARG)
+                break;
+            rc = lex_cmd(&lx, out);
+            if (cls == CH_IN) {
+                lx.target = LEX_IN;
+            } else if (p[1] == '>') {
+                lx.target = LEX_APPEND;
+                p++;
+            } else {
+                lx.target = LEX_OUT;
+            }
         }
-        token = strtok_r(NULL, PIPE_STRING, &saveptr);
     }
+    if (rc == OK && lx.target != LEX_ARG)
+        rc = ERR_CMD_ARGS_BAD;      // redirect without a file, or two in a row
+    if (rc == OK && clist->num > 0 && !lx.cmd)
+        rc = ERR_CMD_ARGS_BAD;      // nothing after the last '|'
+    if (rc != OK)
+        return rc;
     if (clist->num == 0)
         return WARN_NO_CMDS;
+    for (int n = 0; n < clist->num; n++) {
+        if (clist->commands[n].argc == 0)
+            return ERR_CMD_ARGS_BAD; // only redirects, nothing to run
+    }
     return OK;
 }
 
 /* free_cmd_list
- * Frees the command buffers for each command in the list.
+ * Releases everything the list's commands point to by resetting the
+ * arena, O(1) however many commands and arguments the line had.
  */
 int free_cmd_list(command_list_t *cmd_lst) {
-    for (int i = 0; i < cmd_lst->num; i++)
-        free_cmd_buff(&cmd_lst->commands[i]);
     cmd_lst->num = 0;
+    cmd_lst->arena.used = 0;
     return OK;
 }
 
-/* exec_local_cmd_loop
- * Main shell loop:
- *   - Prints the prompt (SH_PROMPT)
- *   - Reads user input via fgets()
- *   - Parses the input and executes the command(s) without extra headers.
- *   - Continues until the user enters the exit command.
+/* close_cmd_list
+ * Frees the commands and the arena themselves, once the shell is done
+ * with the list.
  */
-int exec_local_cmd_loop() {
-    char cmd_line[SH_CMD_MAX];
-    command_list_t clist;
-    cmd_buff_t cmd;
+int close_cmd_list(command_list_t *cmd_lst) {
+    free_cmd_list(cmd_lst);
+    free(cmd_lst->commands);
+    cmd_lst->commands = NULL;
+    cmd_lst->cap = 0;
+    free(cmd_lst->arena.base);
+    cmd_lst->arena = (cmd_arena_t){ NULL, 0, 0 };
+    return OK;
+}
+
+/* cmd_error
+ * Prints an error to stderr. When the shell is not reading from a
+ * terminal it is prefixed with the input's name and line number, like
+ * "script: line 12: execvp: No such file or directory".
+ */
+void cmd_error(const char *fmt, ...) {
+    va_list ap;
+    if (cur_input && cur_input->name)
+        fprintf(stderr, "%s: line %ld: ", cur_input->name, cur_input->line);
+    va_start(ap, fmt);
+    vfprintf(stderr, fmt, ap);
+    va_end(ap);
+}
+
+/* cmd_loop
+ * Command loop over one input:
+ *   - Prints the prompt (SH_PROMPT), unless the input is a script
+ *   - Reads the input via getline(), so a line can be any length
+ *   - Parses the input into the command list and executes the command(s)
+ *     without extra headers. The line buffer, the list and its arena are
+ *     reused every line.
+ *   - In a script, skips blank and '#' lines and flushes builtin output
+ *     so it stays in order with the commands' output.
+ *   - Runs a line ending in '&' as a background job and reports finished
+ *     jobs before the next prompt.
+ *   - Continues until the exit command or the end of the input.
+ */
+static int cmd_loop(cmd_input_t *src) {
+    char *cmd_line = NULL;
+    size_t line_cap = 0;
+    command_list_t clist = { 0 };
+    cur_input = src;
     while (1) {
-        printf("%s", SH_PROMPT);
-        if (!fgets(cmd_line, SH_CMD_MAX, stdin)) { 
-            printf("\n"); 
+        // Finished jobs are reported before the prompt, a script keeps
+        // them for wait.
+        if (src->script) {
+            jobs_reap();
+        } else {
+            jobs_notify();
+            printf("%s", SH_PROMPT);
+        }
+        ssize_t n = getline(&cmd_line, &line_cap, src->in);
+        if (n < 0) { 
+            if (!src->script)
+                printf("\n"); 
             break; 
         }
+        src->line++;
         // Remove trailing newline.
-        cmd_line[strcspn(cmd_line, "\n")] = '\0';
+        if (n > 0 && cmd_line[n - 1] == '\n')
+            cmd_line[n - 1] = '\0';
+        if (src->script) {
+            const char *p = cmd_line + strspn(cmd_line, " \t");
+            if (*p == '\0' || *p == '#')
+                continue;
+        }
         if (strlen(cmd_line) == 0) { 
             printf("%s\n", CMD_WARN_NO_CMD); 
             continue; 
         }
-        // Check for pipeline commands.
-        if (strchr(cmd_line, PIPE_CHAR)) {
-            int rc = build_cmd_list(cmd_line, &clist);
-            if (rc == WARN_NO_CMDS) { 
-                printf("%s\n", CMD_WARN_NO_CMD); 
-                continue; 
-            } else if (rc == ERR_TOO_MANY_COMMANDS) { 
-                fprintf(stderr, CMD_ERR_PIPE_LIMIT, CMD_MAX); 
-                fprintf(stderr, "\n"); 
-                continue; 
-            } else if (rc != OK) { 
-                fprintf(stderr, "error building command list\n"); 
-                continue; 
-            }
+        int rc = build_cmd_list(cmd_line, &clist);
+        if (rc == WARN_NO_CMDS) { 
+            printf("%s\n", CMD_WARN_NO_CMD); 
+            continue; 
+        } else if (rc != OK) { 
+            cmd_error("error building command list\n"); 
+            continue; 
+        }
+        // A line ending in '&' becomes a job, a pipe a pipeline command.
+        if (clist.background) {
+            rc = execute_background(&clist, cmd_line);
+            if (rc != OK)
+                cmd_error("background execution failed\n");
+        } else if (clist.num > 1) {
             rc = execute_pipeline(&clist);
             if (rc != OK) 
-                fprintf(stderr, "pipeline execution failed\n");
-            free_cmd_list(&clist);
+                cmd_error("pipeline execution failed\n");
         } else {
             // Process a single command.
-            int rc = build_cmd_buff(cmd_line, &cmd);
-            if (rc == WARN_NO_CMDS) { 
-                printf("%s\n", CMD_WARN_NO_CMD); 
-                continue; 
-            } else if (rc != OK) { 
-                fprintf(stderr, "error building command buffer\n"); 
-                continue; 
-            }
-            Built_In_Cmds bi = exec_built_in_cmd(&cmd);
+            cmd_buff_t *cmd = &clist.commands[0];
+            Built_In_Cmds bi = exec_built_in_cmd(cmd);
             if (bi == BI_CMD_EXIT) { 
-                free_cmd_buff(&cmd); 
+                free_cmd_list(&clist); 
                 break; 
             }
             if (bi == BI_NOT_BI) { 
-                rc = exec_cmd(&cmd); 
+                rc = exec_cmd(cmd); 
                 if (rc == ERR_EXEC_CMD) 
-                    fprintf(stderr, "command execution failed\n"); 
+                    cmd_error("command execution failed\n"); 
+            } else if (src->script) {
+                fflush(stdout);
             }
-            free_cmd_buff(&cmd);
         }
+        free_cmd_list(&clist);
     }
+    close_cmd_list(&clist);
+    free(cmd_line);
+    cur_input = NULL;
     return OK;
-}
\ No newline at end of file
+}
+
+/* exec_local_cmd_loop
+ * Main shell loop on stdin, with a prompt for every line. Input that is
+ * not a terminal is read in SCRIPT_BUFF_SZ blocks and its errors carry
+ * line numbers. The prompts stay, the assignment tests expect them.
+ */
+int exec_local_cmd_loop() {
+    cmd_input_t src = { stdin, NULL, 0, false };
+    if (!isatty(STDIN_FILENO)) {
+        setvbuf(stdin, NULL, _IOFBF, SCRIPT_BUFF_SZ);
+        src.name = "stdin";
+    }
+    return cmd_loop(&src);
+}
+
+/* exec_script
+ * dsh -f path: runs a script with no prompts, "-" reads it from stdin.
+ * Returns the status of the last command, for the shell's exit status.
+ */
+int exec_script(const char *path) {
+    cmd_input_t src = { stdin, "stdin", 0, true };
+    if (strcmp(path, "-") != 0) {
+        src.in = fopen(path, "re");
+        if (!src.in) {
+            fprintf(stderr, "dsh: %s: %s\n", path, strerror(errno));
+            return SCRIPT_NOT_FOUND;
+        }
+        src.name = path;
+    }
+    setvbuf(src.in, NULL, _IOFBF, SCRIPT_BUFF_SZ);
+    cmd_loop(&src);
+    if (src.in != stdin)
+        fclose(src.in);
+    return last_return_code < 0 ? 1 : last_return_code;
+}
@@ -4,10 +4,9 @@
 //Constants for command structure sizes
 #define EXE_MAX 64
 #define ARG_MAX 256
-#define CMD_MAX 8
-#define CMD_ARGV_MAX (CMD_MAX + 1)
-// Longest command that can be read from the shell
-#define SH_CMD_MAX EXE_MAX + ARG_MAX
+// Starting size of a command list, it doubles when a pipeline is longer.
+// Lines, argument counts and pipeline lengths have no fixed limit.
+#define CMD_LIST_MIN 8
 
 typedef struct command{
     char exe[EXE_MAX];
@@ -15,25 +14,46 @@ typedef struct command{
 } command_t;
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <sys/types.h>
 
 typedef struct cmd_buff{
     int  argc;
-    char *argv[CMD_ARGV_MAX];
+    char **argv;       // NULL terminated, in the command list's arena
     char *_cmd_buffer;
     char *input_file;  // extra credit, stores input redirection file (for `<`)
     char *output_file; // extra credit, stores output redirection file (for `>`)
     bool append_mode; // extra credit, sets append mode fomr output_file
+    pid_t pid;         // the stage's process while a pipeline runs
+    int status;        // its wait status once it has been reaped
 } cmd_buff_t;
 
+// Per-line bump arena.  build_cmd_list() copies the line into it once and
+// every token, argv array and redirect filename points into that copy, so
+// no command owns memory of its own.  free_cmd_list() resets used in O(1);
+// the block is kept and only grows when a longer line comes in.
+#define CMD_ARENA_MIN 1024
+
+typedef struct cmd_arena{
+    char   *base;
+    size_t  used;
+    size_t  cap;
+}cmd_arena_t;
+
 typedef struct command_list{
     int num;
-    cmd_buff_t commands[CMD_MAX];
+    int cap;                // commands allocated
+    cmd_buff_t *commands;   // grows by doubling, kept between lines
+    cmd_arena_t arena;
+    bool background;        // the line ended with '&'
 }command_list_t;
 
 //Special character #defines
 #define SPACE_CHAR  ' '
 #define PIPE_CHAR   '|'
 #define PIPE_STRING "|"
+#define BG_CHAR     '&'
 #define SH_PROMPT       "dsh4> "
 #define EXIT_CMD        "exit"
 #define RC_SC           99
@@ -53,10 +73,10 @@ typedef struct command_list{
 int alloc_cmd_buff(cmd_buff_t *cmd_buff);
 int free_cmd_buff(cmd_buff_t *cmd_buff);
 int clear_cmd_buff(cmd_buff_t *cmd_buff);
-int build_cmd_buff(char *cmd_line, cmd_buff_t *cmd_buff);
 int close_cmd_buff(cmd_buff_t *cmd_buff);
 int build_cmd_list(char *cmd_line, command_list_t *clist);
 int free_cmd_list(command_list_t *cmd_lst);
+int close_cmd_list(command_list_t *cmd_lst);
 
 //built in command stuff
 typedef enum {
@@ -65,22 +85,95 @@ typedef enum {
     BI_CMD_CD,
     BI_CMD_RC,              //extra credit command
     BI_CMD_STOP_SVR,        //new command "stop-server"
+    BI_CMD_HASH,            //path cache, hash and hash -r
+    BI_CMD_JOBS,            //background jobs, jobs, wait and fg
+    BI_CMD_WAIT,
+    BI_CMD_FG,
+    BI_CMD_PARALLEL,        //parallel [-j N] cmd {} ::: args
+    BI_CMD_SET,             //set -o pipefail, set -o failfast
     BI_NOT_BI,
     BI_EXECUTED,
 } Built_In_Cmds;
 Built_In_Cmds match_command(const char *input); 
 Built_In_Cmds exec_built_in_cmd(cmd_buff_t *cmd);
 
+//where the command loop reads from, a script run with dsh -f gets no
+//prompts and name is set when errors should carry line numbers
+#define SCRIPT_BUFF_SZ   (64 * 1024)    //input is read in blocks this big
+#define SCRIPT_NOT_FOUND 127            //exit status when it cannot be opened
+
+typedef struct cmd_input{
+    FILE *in;
+    const char *name;   // NULL for a terminal
+    long line;          // of the line being run
+    bool script;
+}cmd_input_t;
+
 //main execution context
 int exec_local_cmd_loop();
+int exec_script(const char *path);
+void cmd_error(const char *fmt, ...);
 int exec_cmd(cmd_buff_t *cmd);
 int execute_pipeline(command_list_t *clist);
+int wait_pipeline(command_list_t *clist, int started);
+int execute_background(command_list_t *clist, const char *cmd_line);
 void setup_redirection(cmd_buff_t *cmd);
 void print_dragon();
 
+//process launch, posix_spawn with the fork/execvp path as a fallback,
+//picked with set_launch_mode() or DSH_LAUNCH=fork
+#define LAUNCH_ENV "DSH_LAUNCH"
+typedef enum {
+    LAUNCH_SPAWN,
+    LAUNCH_FORK,
+} launch_mode_t;
+void set_launch_mode(launch_mode_t mode);
+launch_mode_t get_launch_mode(void);
+pid_t launch_cmd(cmd_buff_t *cmd, int in_fd, int out_fd);
+
+//shell options, set -o name and set +o name, pipefail makes a pipeline's
+//status its last failed stage's and failfast stops the other stages when
+//one fails
+int exec_set(cmd_buff_t *cmd);
+
+//pipe capacity, set pipesize N, pipes between stages get N bytes up to
+//pipe-max-size and 0 leaves the kernel's default
+#define PIPESIZE_OPT     "pipesize"
+#define PIPE_MAX_PATH    "/proc/sys/fs/pipe-max-size"
+#define PIPE_MAX_DEFAULT (1024 * 1024)  //pipe-max-size when it cannot be read
+int pipe_open(int fds[2]);
+
+//background jobs, started by a line ending in '&', reaped between commands
+//after SIGCHLD writes to a self-pipe, and managed by jobs, wait and fg
+#define JOB_LIST_MIN 8
+#define JOB_NOT_FOUND 127   //wait status for a job or pid that is not ours
+void jobs_reap(void);
+void jobs_notify(void);
+void jobs_print(void);
+int jobs_wait(const char *spec);
+int jobs_fg(const char *spec);
+
+//the parallel builtin, xargs -P with the output kept in the order of the
+//args: parallel [-j N] command [{}] [::: arg...]
+#define PAR_ARG      "{}"           //replaced by the arg in each word
+#define PAR_SEP      ":::"          //the args follow, else read from stdin
+#define PAR_JOBS_CPU 4              //-j is capped at this many jobs per CPU
+#define PAR_BACKLOG  4              //jobs ahead of the output, per running job
+#define PAR_COPY_SZ  (64 * 1024)    //output is copied out in blocks this big
+#define PAR_FAIL_MAX 101            //status is the failed job count, up to this
+int exec_parallel(cmd_buff_t *cmd);
+
+//PATH lookup cache, command name to the path found for it, listed by the
+//hash builtin and emptied by hash -r, safe to use from the server's
+//client threads
+#define PATH_CACHE_MIN 64
+const char *path_cache_lookup(const char *name, bool hit, char *buf, size_t size);
+void path_cache_forget(const char *name);
+void path_cache_reset(void);
+void path_cache_print(void);
+
 //output constants
 #define CMD_OK_HEADER       "PARSED COMMAND LINE - TOTAL COMMANDS %d\n"
 #define CMD_WARN_NO_CMD     "warning: no commands provided\n"
-#define CMD_ERR_PIPE_LIMIT  "error: piping limited to %d commands\n"
 #define BI_NOT_IMPLEMENTED "not implemented"
 #endif
\ No newline at end of file
@@ -209,8 +209,7 @@ void *handle_client(void *arg) {
  *    ERR_RDSH_COMMUNICATION - on a socket or memory error
  */
 int exec_client_requests(int cli_socket) {
-    command_list_t cmd_list;
-    cmd_list.num = 0;
+    command_list_t cmd_list = { 0 };    // its arena is reused for every command
 
     char *io_buff = malloc(RDSH_COMM_BUFF_SZ);
     if (io_buff == NULL) {
@@ -224,6 +223,7 @@ int exec_client_requests(int cli_socket) {
         if (io_size < 0) {
             perror("recv");
             free(io_buff);
+            close_cmd_list(&cmd_list);
             return ERR_RDSH_COMMUNICATION;
         }
         if (io_size == 0) {
@@ -239,10 +239,12 @@ int exec_client_requests(int cli_socket) {
         // Check for built-in commands
         if (strcmp(io_buff, EXIT_CMD) == 0) {
             free(io_buff);
+            close_cmd_list(&cmd_list);
             return OK;       // client wants to exit
         }
         if (strcmp(io_buff, "stop-server") == 0) {
             free(io_buff);
+            close_cmd_list(&cmd_list);
             return OK_EXIT; // signal to stop the server
         }
 
@@ -254,6 +256,14 @@ int exec_client_requests(int cli_socket) {
             continue;
         }
 
+        // A background job's output would arrive after this command's EOF
+        // marker and mix into the next reply, so '&' is local only
+        if (cmd_list.background) {
+            free_cmd_list(&cmd_list);
+            send_message_string(cli_socket, CMD_ERR_RDSH_BG);
+            continue;
+        }
+
         // Execute pipeline
         rc = rsh_execute_pipeline(cli_socket, &cmd_list);
         if (rc != OK) {
@@ -266,6 +276,7 @@ int exec_client_requests(int cli_socket) {
     }
 
     free(io_buff);
+    close_cmd_list(&cmd_list);
     return OK;
 }
 
@@ -301,100 +312,61 @@ int send_message_string(int cli_socket, char *buff) {
  *  Adapts the local execute_pipeline() logic for networked I/O:
  *    - The first command’s stdin is dup2’d to cli_sock.
  *    - The last command’s stdout is dup2’d to cli_sock.
- *    - Intermediate commands use pipes.
+ *    - Intermediate commands use pipes, each created just before the
+ *      stage that writes to it, so any number of commands can run.
+ *  Commands are started with launch_cmd(), so a server with a large heap
+ *  does not pay for copying it on every command.
  */
 int rsh_execute_pipeline(int cli_sock, command_list_t *clist) {
     int num = clist->num;
     if (num < 1) {
         return WARN_NO_CMDS;
     }
-    if (num > CMD_MAX) {
-        fprintf(stderr, CMD_ERR_PIPE_LIMIT, CMD_MAX);
-        fprintf(stderr, "\n");
-        return ERR_TOO_MANY_COMMANDS;
-    }
 
-    // Create pipes
-    int pipes[CMD_MAX - 1][2];
-    for (int i = 0; i < num - 1; i++) {
-        if (pipe(pipes[i]) == -1) {
+    int in_fd = cli_sock;   // What the next stage reads from
+    int started = 0;
+    int rc = OK;
+
+    for (int i = 0; i < num; i++) {
+        cmd_buff_t *cmd = &clist->commands[i];
+        int fds[2] = { -1, cli_sock };
+
+        // Every command but the last writes into a new pipe, close on
+        // exec so only the ends on stdin and stdout reach the children
+        if (i < num - 1 && pipe_open(fds) == -1) {
             perror("pipe");
-            exit(EXIT_FAILURE);
+            rc = ERR_RDSH_CMD_EXEC;
+            break;
         }
-    }
-
-    pid_t pids[CMD_MAX];
-    int status_arr[CMD_MAX];
+        pid_t pid = launch_cmd(cmd, in_fd, fds[1]);
 
-    for (int i = 0; i < num; i++) {
-        pid_t pid = fork();
-        if (pid < 0) {
-            perror("fork");
-            exit(EXIT_FAILURE);
+        // Parent keeps only the read end, for the next command
+        if (in_fd != cli_sock) {
+            close(in_fd);
         }
-        if (pid == 0) {
-            // Child
-            // Redirect stdin
-            if (i == 0) {
-                if (dup2(cli_sock, STDIN_FILENO) < 0) {
-                    perror("dup2 cli_sock -> STDIN");
-                    exit(errno);
-                }
-            } else {
-                if (dup2(pipes[i - 1][0], STDIN_FILENO) < 0) {
-                    perror("dup2 pipe -> STDIN");
-                    exit(errno);
-                }
-            }
-
-            // Redirect stdout
-            if (i == num - 1) {
-                if (dup2(cli_sock, STDOUT_FILENO) < 0) {
-                    perror("dup2 cli_sock -> STDOUT");
-                    exit(errno);
-                }
-            } else {
-                if (dup2(pipes[i][1], STDOUT_FILENO) < 0) {
-                    perror("dup2 STDOUT -> pipe");
-                    exit(errno);
-                }
-            }
-
-            // Close all pipes in child
-            for (int j = 0; j < num - 1; j++) {
-                close(pipes[j][0]);
-                close(pipes[j][1]);
-            }
-
-            // Setup any file redirection
-            setup_redirection(&clist->commands[i]);
-
-            // Execute command
-            if (execvp(clist->commands[i].argv[0], clist->commands[i].argv) == -1) {
-                perror("execvp");
-                exit(errno);
-            }
-        } else {
-            // Parent
-            pids[i] = pid;
+        if (fds[0] >= 0) {
+            close(fds[1]);
         }
+        in_fd = fds[0];
+        if (pid < 0) {
+            rc = ERR_RDSH_CMD_EXEC;
+            break;
+        }
+        started++;
     }
-
-    // Parent closes all pipes
-    for (int i = 0; i < num - 1; i++) {
-        close(pipes[i][0]);
-        close(pipes[i][1]);
+    if (in_fd >= 0 && in_fd != cli_sock) {
+        close(in_fd);
     }
 
-    // Wait for all children
-    for (int i = 0; i < num; i++) {
-        waitpid(pids[i], &status_arr[i], 0);
+    // Reap the children as they finish
+    int exit_code = started > 0 ? wait_pipeline(clist, started) : 0;
+    if (rc != OK) {
+        return rc;
     }
 
-    // Determine the exit code of the last process
-    int exit_code = WEXITSTATUS(status_arr[num - 1]);
+    // The exit code of the last process, unless one asked for EXIT_SC
     for (int i = 0; i < num; i++) {
-        if (WEXITSTATUS(status_arr[i]) == EXIT_SC) {
+        if (WEXITSTATUS(clist->commands[i].status) == EXIT_SC) {
             exit_code = EXIT_SC;
         }
     }